@@ -1,21 +1,32 @@
 # Compile glsl files into SPIR-V files
 # depends on glslc installed by LunarG SDK
 
-# Usage: target_shader_sources(<target> [<file> ...])
+# Usage: target_shader_sources(<target> [EMBED] [<file> ...])
+#  EMBED: also compile each file into a constexpr uint32_t array, listed in generated
+#         <embedded_shaders.hpp> as embedded_shaders::all {"<folder>/<file>.spv", words}
+# Generated <shader_sources.hpp> lists shader_sources::all {"<folder>/<file>.spv", source path, spv path}
+# and shader_sources::glslc, so shaders can be rebuilt at runtime.
 function (target_shader_sources TARGET)
 	find_package(Vulkan REQUIRED)
 	if (NOT TARGET Vulkan::glslc)
 		message(FATAL_ERROR "[Error]: Could not find glslc.")
 	endif()
 
-	foreach(source IN LISTS ARGN)
+	cmake_parse_arguments(PARSE_ARGV 1 SHADER "EMBED" "" "")
+
+	set(embed_dir ${CMAKE_CURRENT_BINARY_DIR}/${TARGET}_embedded_shaders)
+	set(embed_arrays "")
+	set(embed_entries "")
+	set(source_entries "")
+
+	foreach(source IN LISTS SHADER_UNPARSED_ARGUMENTS)
 		get_filename_component(source_fldr ${source} DIRECTORY)
 		get_filename_component(source_abs ${source} ABSOLUTE)
 		get_filename_component(basename ${source_abs} NAME)
 
 		set(shader_dir ${EXECUTABLE_OUTPUT_PATH}/${source_fldr})
 		set(output ${shader_dir}/${basename}.spv)
-		
+
 		if(NOT EXISTS ${source_abs})
 			message(FATAL_ERROR "Cannot file shader file: ${source}")
 		endif()
@@ -28,11 +39,64 @@ function (target_shader_sources TARGET)
 			COMMENT "Compiling SPIRV: ${source} -> ${output}"
 			VERBATIM
 		)
+		set(outputs ${output})
+
+		if (source_fldr)
+			set(spv_name "${source_fldr}/${basename}.spv")
+		else()
+			set(spv_name "${basename}.spv")
+		endif()
+		string(APPEND source_entries
+			"\t\tstd::tuple<std::string_view, std::string_view, std::string_view>{ \"${spv_name}\", \"${source_abs}\", \"${output}\" },\n")
+
+		if (SHADER_EMBED)
+			string(MAKE_C_IDENTIFIER "${spv_name}" spv_identifier)
+			set(embed_output ${embed_dir}/${spv_name}.inl)
+
+			# -mfmt=c writes a C initializer list of 32-bit words
+			add_custom_command(
+				OUTPUT ${embed_output}
+				COMMAND ${CMAKE_COMMAND} -E make_directory ${embed_dir}/${source_fldr}
+				COMMAND Vulkan::glslc ${source_abs} -mfmt=c -o ${embed_output}
+				DEPENDS ${source_abs}
+				COMMENT "Embedding SPIRV: ${source} -> ${embed_output}"
+				VERBATIM
+			)
+			list(APPEND outputs ${embed_output})
+
+			string(APPEND embed_arrays
+				"\tinline constexpr uint32_t ${spv_identifier}[] =\n#include \"${spv_name}.inl\"\n\t;\n\n")
+			string(APPEND embed_entries
+				"\t\tstd::tuple<std::string_view, std::span<const uint32_t>>{ \"${spv_name}\", ${spv_identifier} },\n")
+		endif()
 
 		set(shader_target "${TARGET}_${basename}")
 		add_custom_target("${shader_target}"
-		                  DEPENDS "${output}")
+		                  DEPENDS ${outputs})
 		add_dependencies("${TARGET}" "${shader_target}")
 	endforeach()
 
-endfunction()
\ No newline at end of file
+	# file(CONFIGURE) only rewrites when contents change
+	set(sources_dir ${CMAKE_CURRENT_BINARY_DIR}/${TARGET}_shader_sources)
+	file(CONFIGURE
+		OUTPUT ${sources_dir}/shader_sources.hpp
+		CONTENT "#pragma once\n\n// Generated by target_shader_sources, do not edit\n\nnamespace shader_sources\n{\n\tinline constexpr std::string_view glslc = \"${Vulkan_GLSLC_EXECUTABLE}\";\n\n\tinline constexpr auto all = std::array\n\t{\n${source_entries}\t};\n}\n"
+		@ONLY)
+
+	target_include_directories(${TARGET}
+		PRIVATE
+			${sources_dir})
+
+	if (SHADER_EMBED)
+		# only rewritten when shader list changes, contents come from the .inl files
+		file(CONFIGURE
+			OUTPUT ${embed_dir}/embedded_shaders.hpp
+			CONTENT "#pragma once\n\n// Generated by target_shader_sources, do not edit\n\nnamespace embedded_shaders\n{\n${embed_arrays}\tinline constexpr auto all = std::array\n\t{\n${embed_entries}\t};\n}\n"
+			@ONLY)
+
+		target_include_directories(${TARGET}
+			PRIVATE
+				${embed_dir})
+	endif()
+
+endfunction()
@@ -0,0 +1,611 @@
+#include "renderer.hpp"
+#include "scene.hpp"
+
+#include "vk/instance.hpp"
+#include "vk/devices.hpp"
+#include "vk/memory_allocator.hpp"
+#include "vk/upload_service.hpp"
+#include "vk/compute_queue.hpp"
+#include "vk/timeline.hpp"
+#include "vk/pipeline_cache.hpp"
+#include "vk/pipeline.hpp"
+
+using namespace vulkan_eg;
+
+namespace
+{
+	// --stress-scene: instanced quads, enough to make draw submission and vertex throughput show up
+	constexpr auto stress_instance_count = 100'000u;
+	// --record-scaling without --draws: a single draw records too fast for workers to pay off
+	constexpr auto record_scaling_draw_count = 10'000u;
+
+	struct bench_options
+	{
+		uint32_t frames{1000};
+		uint32_t warmup{100};
+		uint32_t width{800};
+		uint32_t height{600};
+		std::filesystem::path output{};
+		bool record_scaling{false};
+		bool validate_compute{false};
+		bool validate_culling{false};
+		render_settings settings{};
+	};
+
+	struct distribution
+	{
+		double mean{};
+		double p50{};
+		double p95{};
+		double p99{};
+		double max{};
+	};
+
+	auto print_usage()
+	{
+		std::cout << "Usage: vulkan-eg-bench [--frames N] [--warmup N] [--width N] [--height N] [--output file.json]\n"
+		             "                       [--profile balanced|low-latency|max-throughput|power-saving] [--frames-in-flight N]\n"
+		             "                       [--record-mode per-frame|cached] [--record-threads N] [--draws N] [--instances N]\n"
+		             "                       [--pipeline-cache file | --no-pipeline-cache] [--record-scaling] [--stress-scene]\n"
+		             "                       [--gpu-culling] [--view-scale F] [--bindless] [--render-path render-pass|dynamic]\n"
+		             "                       [--device index|name] [--capability-cache file | --no-capability-cache]\n"
+		             "                       [--startup-trace file]\n"
+		             "       vulkan-eg-bench --validate-compute\n"
+		             "       vulkan-eg-bench --validate-culling [--instances N] [--view-scale F]\n";
+	}
+
+	auto parse_options(int argc, char *argv[]) -> bench_options
+	{
+		auto opts = bench_options{};
+		auto all_args = std::vector<std::string_view>(argv + 1, argv + argc);
+		auto args = std::vector<std::string_view>{};
+		std::tie(opts.settings, args) = render_settings::from_command_line(all_args);
+
+		for (auto it = args.begin(); it != args.end(); ++it)
+		{
+			auto next_value = [&]() -> std::string_view
+			{
+				if (std::next(it) == args.end())
+				{
+					throw std::invalid_argument(std::format("Missing value for {}", *it));
+				}
+				return *(++it);
+			};
+			auto next_uint = [&]() -> uint32_t
+			{
+				return static_cast<uint32_t>(std::stoul(std::string(next_value())));
+			};
+
+			if (*it == "--frames")
+			{
+				opts.frames = next_uint();
+			}
+			else if (*it == "--warmup")
+			{
+				opts.warmup = next_uint();
+			}
+			else if (*it == "--width")
+			{
+				opts.width = next_uint();
+			}
+			else if (*it == "--height")
+			{
+				opts.height = next_uint();
+			}
+			else if (*it == "--output")
+			{
+				opts.output = next_value();
+			}
+			else if (*it == "--record-scaling")
+			{
+				opts.record_scaling = true;
+			}
+			else if (*it == "--stress-scene")
+			{
+				opts.settings.instance_count = std::max(opts.settings.instance_count, stress_instance_count);
+			}
+			else if (*it == "--validate-compute")
+			{
+				opts.validate_compute = true;
+			}
+			else if (*it == "--validate-culling")
+			{
+				opts.validate_culling = true;
+			}
+			else
+			{
+				throw std::invalid_argument(std::format("Unknown argument {}", *it));
+			}
+		}
+
+		if (opts.frames == 0)
+		{
+			throw std::invalid_argument("--frames must be greater than zero");
+		}
+
+		if (opts.record_scaling and std::ranges::find(all_args, "--draws") == all_args.end())
+		{
+			opts.settings.draw_count = record_scaling_draw_count;
+		}
+
+		return opts;
+	}
+
+	// nearest-rank percentiles
+	auto make_distribution(std::vector<double> samples) -> distribution
+	{
+		std::ranges::sort(samples);
+
+		auto percentile = [&](double p) -> double
+		{
+			auto rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(samples.size())));
+			return samples.at(std::clamp<size_t>(rank, 1, samples.size()) - 1);
+		};
+
+		auto sum = std::accumulate(samples.begin(), samples.end(), 0.0);
+
+		return distribution
+		{
+			.mean = sum / static_cast<double>(samples.size()),
+			.p50 = percentile(50.0),
+			.p95 = percentile(95.0),
+			.p99 = percentile(99.0),
+			.max = samples.back()
+		};
+	}
+
+	auto to_json(const distribution &d) -> std::string
+	{
+		return std::format(R"({{ "mean": {:.4f}, "p50": {:.4f}, "p95": {:.4f}, "p99": {:.4f}, "max": {:.4f} }})",
+		                   d.mean, d.p50, d.p95, d.p99, d.max);
+	}
+
+	struct run_result
+	{
+		std::string device;
+		render_settings settings;
+		renderer::startup_timings startup;
+		double total_seconds{};
+		std::vector<double> frame_times;
+		std::vector<double> wait_frame;
+		std::vector<double> acquire;
+		std::vector<double> record;
+		std::vector<double> submit;
+		std::vector<double> present;
+		std::vector<double> gpu_render_pass;
+		vkw::memory_stats memory;
+	};
+
+	// stderr, so it stays out of the JSON on stdout
+	void report_device(const vkw::device_choice &choice)
+	{
+		std::cerr << std::format("Using {} ({}), score {}, device capabilities: {} cached, {} enumerated\n",
+		                         choice.name, vk::to_string(choice.type), choice.score,
+		                         choice.capabilities_cached, choice.capabilities_enumerated);
+	}
+
+	auto run_benchmark(const bench_options &opts, const render_settings &settings) -> run_result
+	{
+		using timer = std::chrono::steady_clock;
+		using ms = std::chrono::duration<double, std::milli>;
+
+		auto rndr = renderer(vk::Extent2D{opts.width, opts.height}, settings);
+		report_device(rndr.get_device_choice());
+		// measured frames should include the draws
+		rndr.wait_for_pipelines();
+
+		for (auto i = 0u; i < opts.warmup; ++i)
+		{
+			rndr.draw_frame();
+		}
+
+		auto out = run_result
+		{
+			.device = rndr.get_device_name(),
+			.settings = settings,
+			.startup = rndr.get_startup_timings()
+		};
+		out.settings.rendering = rndr.get_render_path();
+
+		auto run_start = timer::now();
+		for (auto i = 0u; i < opts.frames; ++i)
+		{
+			auto frame_start = timer::now();
+			rndr.draw_frame();
+			out.frame_times.push_back(ms(timer::now() - frame_start).count());
+
+			auto &timings = rndr.get_frame_timings();
+			out.wait_frame.push_back(timings.wait_frame);
+			out.acquire.push_back(timings.acquire);
+			out.record.push_back(timings.record);
+			out.submit.push_back(timings.submit);
+			out.present.push_back(timings.present);
+
+			// lags behind by frames in flight, resolved once frame has completed
+			out.gpu_render_pass.push_back(rndr.get_gpu_timings().render_pass);
+		}
+		out.total_seconds = std::chrono::duration<double>(timer::now() - run_start).count();
+		out.memory = rndr.get_memory_stats();
+
+		return out;
+	}
+
+	// quotes, backslashes and control characters, device names come straight from the driver
+	auto escape_json(std::string_view text) -> std::string
+	{
+		auto out = std::string{};
+		for (auto c : text)
+		{
+			switch (c)
+			{
+				case '"':
+					out += R"(\")";
+					break;
+				case '\\':
+					out += R"(\\)";
+					break;
+				case '\n':
+					out += R"(\n)";
+					break;
+				case '\r':
+					out += R"(\r)";
+					break;
+				case '\t':
+					out += R"(\t)";
+					break;
+				default:
+					if (static_cast<unsigned char>(c) < 0x20)
+					{
+						out += std::format(R"(\u{:04x})", static_cast<unsigned char>(c));
+					}
+					else
+					{
+						out += c;
+					}
+			}
+		}
+		return out;
+	}
+
+	auto to_json(const run_result &run, std::string_view indent) -> std::string
+	{
+		auto json = std::format(R"({{
+	"device": "{}",
+	"profile": "{}",
+	"frames_in_flight": {},
+	"record_mode": "{}",
+	"record_threads": {},
+	"draws": {},
+	"instances": {},
+	"gpu_culling": {},
+	"bindless": {},
+	"render_path": "{}",
+	"pipeline_cache": "{}",
+	"pipeline_creation_ms": {:.4f},
+	"frames": {},
+	"total_seconds": {:.4f},
+	"frames_per_second": {:.2f},
+	"frame_time_ms": {},
+	"stages_ms": {{
+		"wait_frame": {},
+		"acquire": {},
+		"record": {},
+		"submit": {},
+		"present": {}
+	}},
+	"gpu_render_pass_ms": {},
+	"memory": {{
+		"reserved_mb": {:.3f},
+		"used_mb": {:.3f},
+		"blocks": {},
+		"allocations": {},
+		"fragmentation": {:.4f}
+	}}
+}})", 
+			escape_json(run.device),
+			to_string(run.settings.profile),
+			run.settings.max_frames_in_flight(),
+			to_string(run.settings.recording),
+			run.settings.record_threads,
+			run.settings.draw_count,
+			run.settings.instance_count,
+			run.settings.gpu_culling,
+			run.settings.bindless,
+			to_string(run.settings.rendering),
+			run.startup.pipeline_cache_warm ? "warm" : "cold",
+			run.startup.pipeline_creation,
+			run.frame_times.size(),
+			run.total_seconds,
+			static_cast<double>(run.frame_times.size()) / run.total_seconds,
+			to_json(make_distribution(run.frame_times)),
+			to_json(make_distribution(run.wait_frame)),
+			to_json(make_distribution(run.acquire)),
+			to_json(make_distribution(run.record)),
+			to_json(make_distribution(run.submit)),
+			to_json(make_distribution(run.present)),
+			to_json(make_distribution(run.gpu_render_pass)),
+			static_cast<double>(run.memory.reserved) / (1024.0 * 1024.0),
+			static_cast<double>(run.memory.used) / (1024.0 * 1024.0),
+			run.memory.block_count,
+			run.memory.allocation_count,
+			run.memory.fragmentation);
+
+		// nest inside an enclosing object/array
+		auto out = std::string{};
+		for (auto c : json)
+		{
+			out += c;
+			if (c == '\n')
+			{
+				out += indent;
+			}
+		}
+		return out;
+	}
+
+	// Uploads input on the transfer queue, transforms it on the compute queue waiting on the upload,
+	// then checks every value read back. Exercises both queues and their semaphores end to end.
+	auto validate_compute() -> bool
+	{
+		constexpr auto value_count = 1u << 16;
+		constexpr auto group_size = 64u; // local_size_x in validate_compute.comp
+
+		auto vkw_instance = vkw::instance("vulkan-eg-bench", "vulkan-eg-bench", VK_MAKE_VERSION(0, 0, 1));
+		auto vkw_devices = vkw::devices(&vkw_instance);
+		report_device(vkw_devices.get_choice());
+		auto device = vkw_devices.get_device();
+		auto allocator = vkw::memory_allocator(&vkw_devices, 1);
+		auto uploads = vkw::upload_service(&vkw_devices, &allocator);
+		auto compute = vkw::compute_queue(&vkw_devices);
+		auto cache = vkw::pipeline_cache(&vkw_devices, {});
+		auto factory = vkw::pipeline_factory(device, &cache);
+
+		auto pipeline = factory.create_compute(
+		{
+			.shader = vkw::shader_code::load("shaders/validate_compute.comp.spv")
+		});
+
+		auto families = vkw_devices.get_queue_family().get_unique_indices();
+		auto buffer_ci = vk::BufferCreateInfo
+		{
+			.size = value_count * sizeof(uint32_t),
+			.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			.sharingMode = families.size() > 1 ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive,
+			.queueFamilyIndexCount = static_cast<uint32_t>(families.size()),
+			.pQueueFamilyIndices = families.data()
+		};
+		auto [input, input_memory] = allocator.create_buffer(buffer_ci, vkw::memory_usage::gpu_only);
+		auto [output, output_memory] = allocator.create_buffer(buffer_ci, vkw::memory_usage::readback);
+
+		auto values = std::vector<uint32_t>(value_count);
+		std::ranges::generate(values, [n = 0u]() mutable { return n++ * 7u; });
+		uploads.upload_buffer(input, 0, std::as_bytes(std::span(values)));
+		auto upload_value = uploads.flush();
+
+		auto pool_size = vk::DescriptorPoolSize
+		{
+			.type = vk::DescriptorType::eStorageBuffer,
+			.descriptorCount = 2
+		};
+		auto descriptor_pool = device.createDescriptorPool(
+		{
+			.maxSets = 1,
+			.poolSizeCount = 1,
+			.pPoolSizes = &pool_size
+		});
+		auto set_layout = pipeline->get_set_layouts().front();
+		auto descriptor_set = device.allocateDescriptorSets(
+		{
+			.descriptorPool = descriptor_pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &set_layout
+		}).front();
+
+		auto buffer_infos = std::array
+		{
+			vk::DescriptorBufferInfo{ .buffer = input, .offset = 0, .range = VK_WHOLE_SIZE },
+			vk::DescriptorBufferInfo{ .buffer = output, .offset = 0, .range = VK_WHOLE_SIZE },
+		};
+		device.updateDescriptorSets(vk::WriteDescriptorSet
+		{
+			.dstSet = descriptor_set,
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = static_cast<uint32_t>(buffer_infos.size()),
+			.descriptorType = vk::DescriptorType::eStorageBuffer,
+			.pBufferInfo = buffer_infos.data()
+		}, {});
+
+		auto waits = std::array{ vkw::compute_queue::semaphore_wait{ uploads.get_timeline().get(), upload_value } };
+		auto done = compute.submit([&](vk::CommandBuffer &cmd_buffer)
+		{
+			cmd_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline->get());
+			cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline->get_layout(), 0, descriptor_set, {});
+			cmd_buffer.pushConstants(pipeline->get_layout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(value_count), &value_count);
+			cmd_buffer.dispatch((value_count + group_size - 1) / group_size, 1, 1);
+
+			// make shader writes visible to host reads once the timeline signals
+			auto to_host = vk::MemoryBarrier
+			{
+				.srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+				.dstAccessMask = vk::AccessFlagBits::eHostRead
+			};
+			cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost,
+			                           {}, to_host, {}, {});
+		}, waits);
+		compute.get_timeline().wait(done);
+
+		auto results = std::span(reinterpret_cast<const uint32_t *>(output_memory.mapped), value_count);
+		auto mismatches = 0u;
+		for (auto &&[i, result] : ranges::views::enumerate(results))
+		{
+			auto expected = values[i] * 2u + 1u;
+			if (result != expected)
+			{
+				if (mismatches++ < 8)
+				{
+					std::cerr << std::format("compute validation: value {} is {}, expected {}\n", i, result, expected);
+				}
+			}
+		}
+
+		std::cout << std::format("compute validation on {} ({} compute queue, {} transfer queue): {} of {} values wrong\n",
+		                         vkw_devices.get_physical_device().getProperties().deviceName.data(),
+		                         compute.has_dedicated_queue() ? "dedicated" : "graphics",
+		                         uploads.has_dedicated_queue() ? "dedicated" : "graphics",
+		                         mismatches, value_count);
+
+		device.destroyDescriptorPool(descriptor_pool);
+		allocator.destroy_buffer(output, output_memory);
+		allocator.destroy_buffer(input, input_memory);
+
+		return mismatches == 0;
+	}
+
+	// Renders a few culled frames, then compares instances the GPU kept with the CPU reference.
+	// Instances within rounding distance of the frustum edge may go either way.
+	auto validate_culling(const bench_options &opts) -> bool
+	{
+		auto settings = opts.settings;
+		settings.gpu_culling = true;
+		if (settings.instance_count == 0)
+		{
+			settings.instance_count = stress_instance_count;
+		}
+		if (settings.view_scale == 1.0f)
+		{
+			// zoomed in, so a good part of the grid is off screen
+			settings.view_scale = 2.0f;
+		}
+
+		auto rndr = renderer(vk::Extent2D{opts.width, opts.height}, settings);
+		report_device(rndr.get_device_choice());
+		rndr.wait_for_pipelines();
+		for (auto i = 0u; i <= settings.max_frames_in_flight(); ++i)
+		{
+			rndr.draw_frame();
+		}
+		auto gpu_visible = rndr.read_visible_instances();
+
+		auto instances = make_grid_instances(settings.instance_count);
+		auto view = make_view_transform(settings.view_scale);
+		constexpr auto tolerance = 1e-5f;
+		auto must_keep = cull_instances(instances, view, -tolerance);
+		auto may_keep = cull_instances(instances, view, tolerance);
+
+		auto kept_all = std::ranges::includes(gpu_visible, must_keep);
+		auto kept_only = std::ranges::includes(may_keep, gpu_visible);
+		auto unique = std::ranges::adjacent_find(gpu_visible) == gpu_visible.end();
+
+		std::cout << std::format("culling validation on {}: GPU kept {} of {} instances, CPU reference {} to {}{}\n",
+		                         rndr.get_device_name(), gpu_visible.size(), settings.instance_count,
+		                         must_keep.size(), may_keep.size(),
+		                         kept_all and kept_only and unique ? "" : " - MISMATCH");
+
+		return kept_all and kept_only and unique;
+	}
+
+	// inline recording, then 1, 2, 4, ... workers up to hardware thread count
+	auto record_thread_counts() -> std::vector<uint32_t>
+	{
+		auto counts = std::vector<uint32_t>{0};
+		auto max_threads = std::max(1u, std::thread::hardware_concurrency());
+		for (auto n = 1u; n < max_threads; n *= 2)
+		{
+			counts.push_back(n);
+		}
+		counts.push_back(max_threads);
+		return counts;
+	}
+}
+
+auto main(int argc, char *argv[]) -> int
+{
+	auto opts = bench_options{};
+	try
+	{
+		opts = parse_options(argc, argv);
+	}
+	catch (std::exception &err)
+	{
+		std::cerr << err.what() << "\n";
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	if (opts.validate_compute)
+	{
+		try
+		{
+			return validate_compute() ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		catch (std::exception &err)
+		{
+			std::cerr << std::format("compute validation failed: {}\n", err.what());
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (opts.validate_culling)
+	{
+		try
+		{
+			return validate_culling(opts) ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+		catch (std::exception &err)
+		{
+			std::cerr << std::format("culling validation failed: {}\n", err.what());
+			return EXIT_FAILURE;
+		}
+	}
+
+	auto json = std::string{};
+	if (opts.record_scaling)
+	{
+		auto runs = std::string{};
+		for (auto threads : record_thread_counts())
+		{
+			auto settings = opts.settings;
+			settings.record_threads = threads;
+
+			runs += runs.empty() ? "" : ",\n\t\t";
+			runs += to_json(run_benchmark(opts, settings), "\t\t");
+		}
+
+		json = std::format(R"({{
+	"width": {},
+	"height": {},
+	"warmup_frames": {},
+	"record_scaling": [
+		{}
+	]
+}}
+)", 
+			opts.width, opts.height, opts.warmup,
+			runs);
+	}
+	else
+	{
+		json = std::format(R"({{
+	"width": {},
+	"height": {},
+	"warmup_frames": {},
+	"run": {}
+}}
+)", 
+			opts.width, opts.height, opts.warmup,
+			to_json(run_benchmark(opts, opts.settings), "\t"));
+	}
+
+	if (opts.output.empty())
+	{
+		std::cout << json;
+	}
+	else
+	{
+		auto file = std::ofstream(opts.output);
+		file << json;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -1,19 +1,55 @@
 #include "window.hpp"
 #include "renderer.hpp"
+#include "vk/devices.hpp"
 
-auto main() -> int
+auto main(int argc, char *argv[]) -> int
 {
 	std::cout << "Working Directory: ";
 	std::cout << std::filesystem::current_path() << "\n";
 
 	using namespace vulkan_eg;
 
+	auto settings = render_settings{};
+	try
+	{
+		auto args = std::vector<std::string_view>(argv + 1, argv + argc);
+		auto remaining = std::vector<std::string_view>{};
+		std::tie(settings, remaining) = render_settings::from_command_line(args);
+		if (not remaining.empty())
+		{
+			throw std::invalid_argument(std::format("Unknown argument {}", remaining.front()));
+		}
+	}
+	catch (std::exception &err)
+	{
+		std::cerr << err.what() << "\n";
+		std::cerr << "Usage: vulkan-eg [--profile balanced|low-latency|max-throughput|power-saving] [--frames-in-flight N]\n"
+		             "                [--record-mode per-frame|cached] [--record-threads N] [--draws N]\n"
+		             "                [--instances N] [--gpu-culling] [--view-scale F] [--bindless]\n"
+		             "                [--render-path render-pass|dynamic] [--device index|name]\n"
+		             "                [--capability-cache file | --no-capability-cache]\n"
+		             "                [--pipeline-cache file | --no-pipeline-cache] [--hot-reload] [--startup-trace file]\n";
+		return EXIT_FAILURE;
+	}
+
 	// Create Window
 	auto wnd = window(L"Vulkan Example",
 	                  {800, 600});
+
+	// Create Renderer
+	auto rndr = renderer(wnd.handle(), settings);
+
+	auto &choice = rndr.get_device_choice();
+	std::cout << std::format("Using {} ({}), score {}, device capabilities: {} cached, {} enumerated\n",
+	                         choice.name, vk::to_string(choice.type), choice.score,
+	                         choice.capabilities_cached, choice.capabilities_enumerated);
+
+	auto &startup = rndr.get_startup_timings();
+	auto startup_reported{false};
 	
 	auto is_close{false};
 	auto is_active{false};
+	auto is_minimized{false};
 	wnd.set_message_callback(window::message_type::keypress,
 	                         [&](uintptr_t key_code, uintptr_t extension) -> bool
 	{
@@ -35,18 +71,37 @@ auto main() -> int
 		return true;
 	});
 
-	// Create Renderer
-	auto rndr = renderer(wnd.handle());
+	wnd.set_message_callback(window::message_type::resize,
+	                         [&](uintptr_t resize_type, uintptr_t size) -> bool
+	{
+		is_minimized = (resize_type == SIZE_MINIMIZED);
+		rndr.resize();
+		return true;
+	});
 
 	wnd.show();
 	while (wnd.handle() and (not is_close))
 	{
+		if (is_minimized)
+		{
+			// nothing to draw, sleep until there is a message instead of spinning
+			WaitMessage();
+		}
 		wnd.process_messages();
 
 		if (is_active)
 		{
 			rndr.draw_frame();
 		}
+
+		// pipelines compile in background, report once they're in use
+		if (startup.pipelines_ready and not startup_reported)
+		{
+			std::cout << std::format("Pipeline creation: {:.3f} ms ({} pipeline cache)\n", 
+			                         startup.pipeline_creation, 
+			                         startup.pipeline_cache_warm ? "warm" : "cold");
+			startup_reported = true;
+		}
 	}
 	
 	return EXIT_SUCCESS;
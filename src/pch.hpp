@@ -6,6 +6,7 @@
 #include <fstream>
 #include <format>
 #include <string_view>
+#include <span>
 #include <memory>
 #include <functional>
 #include <algorithm>
@@ -17,11 +18,30 @@
 #include <filesystem>
 #include <stdexcept>
 #include <exception>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <unordered_map>
+#include <map>
+#include <numeric>
+#include <limits>
+#include <bit>
+#include <cmath>
+#include <numbers>
+#include <cstring>
+#include <cctype>
+#include <cassert>
 
+#ifdef _WIN32
 #pragma warning(push)
 #pragma warning(disable : 5105)
 #include <Windows.h>
 #pragma warning(pop)
+#endif
 
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
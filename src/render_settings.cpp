@@ -0,0 +1,208 @@
+#include "render_settings.hpp"
+
+using namespace vulkan_eg;
+using namespace std::string_view_literals;
+
+namespace
+{
+	constexpr auto profile_names = std::array
+	{
+		std::tuple{frame_profile::balanced, "balanced"sv},
+		std::tuple{frame_profile::low_latency, "low-latency"sv},
+		std::tuple{frame_profile::max_throughput, "max-throughput"sv},
+		std::tuple{frame_profile::power_saving, "power-saving"sv},
+	};
+
+	constexpr auto record_mode_names = std::array
+	{
+		std::tuple{record_mode::per_frame, "per-frame"sv},
+		std::tuple{record_mode::cached, "cached"sv},
+	};
+
+	constexpr auto render_path_names = std::array
+	{
+		std::tuple{render_path::render_pass, "render-pass"sv},
+		std::tuple{render_path::dynamic, "dynamic"sv},
+	};
+
+	// look up enum value from name, or name from enum value, in one of the tables above
+	template <typename T, typename K, typename V, size_t N>
+	auto find_name(const std::array<std::tuple<K, V>, N> &names, const T &key, std::string_view what) -> const std::tuple<K, V> &
+	{
+		auto iter = std::ranges::find(names, key, [](auto &n) -> const T & { return std::get<T>(n); });
+		if (iter == names.end())
+		{
+			if constexpr (std::is_same_v<T, std::string_view>)
+			{
+				throw std::invalid_argument(std::format("Unknown {} {}", what, key));
+			}
+			else
+			{
+				throw std::invalid_argument(std::format("Unknown {} value {}", what, static_cast<int>(key)));
+			}
+		}
+		return *iter;
+	}
+}
+
+auto render_settings::present_modes() const -> std::vector<vk::PresentModeKHR>
+{
+	using pm = vk::PresentModeKHR;
+
+	switch (profile)
+	{
+		case frame_profile::low_latency:
+			return { pm::eMailbox, pm::eImmediate, pm::eFifoRelaxed, pm::eFifo };
+		case frame_profile::max_throughput:
+			return { pm::eImmediate, pm::eMailbox, pm::eFifoRelaxed, pm::eFifo };
+		case frame_profile::power_saving:
+			return { pm::eFifo };
+		case frame_profile::balanced:
+		default:
+			return { pm::eFifoRelaxed, pm::eFifo };
+	}
+}
+
+auto render_settings::max_frames_in_flight() const -> uint32_t
+{
+	if (frames_in_flight > 0)
+	{
+		return frames_in_flight;
+	}
+
+	switch (profile)
+	{
+		case frame_profile::low_latency:
+			return 1;
+		case frame_profile::max_throughput:
+			return 3;
+		case frame_profile::power_saving:
+		case frame_profile::balanced:
+		default:
+			return 2;
+	}
+}
+
+auto render_settings::from_command_line(const std::vector<std::string_view> &args)
+	-> std::tuple<render_settings, std::vector<std::string_view>>
+{
+	auto settings = render_settings{};
+	auto remaining = std::vector<std::string_view>{};
+
+	for (auto it = args.begin(); it != args.end(); ++it)
+	{
+		auto next_value = [&]() -> std::string_view
+		{
+			if (std::next(it) == args.end())
+			{
+				throw std::invalid_argument(std::format("Missing value for {}", *it));
+			}
+			return *(++it);
+		};
+
+		if (*it == "--profile")
+		{
+			settings.profile = to_frame_profile(next_value());
+		}
+		else if (*it == "--frames-in-flight")
+		{
+			settings.frames_in_flight = static_cast<uint32_t>(std::stoul(std::string(next_value())));
+		}
+		else if (*it == "--record-mode")
+		{
+			settings.recording = to_record_mode(next_value());
+		}
+		else if (*it == "--record-threads")
+		{
+			settings.record_threads = static_cast<uint32_t>(std::stoul(std::string(next_value())));
+		}
+		else if (*it == "--draws")
+		{
+			settings.draw_count = static_cast<uint32_t>(std::stoul(std::string(next_value())));
+		}
+		else if (*it == "--instances")
+		{
+			settings.instance_count = static_cast<uint32_t>(std::stoul(std::string(next_value())));
+		}
+		else if (*it == "--gpu-culling")
+		{
+			settings.gpu_culling = true;
+		}
+		else if (*it == "--view-scale")
+		{
+			settings.view_scale = std::stof(std::string(next_value()));
+		}
+		else if (*it == "--bindless")
+		{
+			settings.bindless = true;
+		}
+		else if (*it == "--render-path")
+		{
+			settings.rendering = to_render_path(next_value());
+		}
+		else if (*it == "--device")
+		{
+			settings.device = next_value();
+		}
+		else if (*it == "--capability-cache")
+		{
+			settings.capability_cache_path = next_value();
+		}
+		else if (*it == "--no-capability-cache")
+		{
+			settings.capability_cache_path.clear();
+		}
+		else if (*it == "--pipeline-cache")
+		{
+			settings.pipeline_cache_path = next_value();
+		}
+		else if (*it == "--no-pipeline-cache")
+		{
+			settings.pipeline_cache_path.clear();
+		}
+		else if (*it == "--hot-reload")
+		{
+			settings.hot_reload = true;
+		}
+		else if (*it == "--startup-trace")
+		{
+			settings.startup_trace_path = next_value();
+		}
+		else
+		{
+			remaining.push_back(*it);
+		}
+	}
+
+	return { settings, remaining };
+}
+
+auto vulkan_eg::to_string(frame_profile profile) -> std::string_view
+{
+	return std::get<std::string_view>(find_name(profile_names, profile, "frame profile"));
+}
+
+auto vulkan_eg::to_frame_profile(std::string_view name) -> frame_profile
+{
+	return std::get<frame_profile>(find_name(profile_names, name, "frame profile"));
+}
+
+auto vulkan_eg::to_string(record_mode mode) -> std::string_view
+{
+	return std::get<std::string_view>(find_name(record_mode_names, mode, "record mode"));
+}
+
+auto vulkan_eg::to_record_mode(std::string_view name) -> record_mode
+{
+	return std::get<record_mode>(find_name(record_mode_names, name, "record mode"));
+}
+
+auto vulkan_eg::to_string(render_path path) -> std::string_view
+{
+	return std::get<std::string_view>(find_name(render_path_names, path, "render path"));
+}
+
+auto vulkan_eg::to_render_path(std::string_view name) -> render_path
+{
+	return std::get<render_path>(find_name(render_path_names, name, "render path"));
+}
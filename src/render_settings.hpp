@@ -0,0 +1,78 @@
+#pragma once
+
+namespace vulkan_eg
+{
+	// Trade-off between latency, throughput and power use
+	enum class frame_profile
+	{
+		balanced,       // fifo relaxed, 2 frames in flight
+		low_latency,    // mailbox or immediate, 1 frame in flight
+		max_throughput, // immediate, 3 frames in flight
+		power_saving,   // fifo, 2 frames in flight
+	};
+
+	// How command buffers are produced each frame
+	enum class record_mode
+	{
+		per_frame, // re-record every frame
+		cached,    // one pre-recorded buffer per target image, re-recorded only when invalidated
+	};
+
+	// How render targets are drawn into
+	enum class render_path
+	{
+		render_pass, // render pass and a frame buffer per target image
+		dynamic,     // dynamic rendering straight into image views, falls back to render_pass before Vulkan 1.3
+	};
+
+	struct render_settings
+	{
+		frame_profile profile{frame_profile::balanced};
+		uint32_t frames_in_flight{0}; // 0 uses profile's default
+		record_mode recording{record_mode::per_frame};
+		uint32_t record_threads{0}; // 0 records on calling thread, otherwise secondary buffers are recorded in parallel
+		uint32_t draw_count{1};     // number of draws per frame
+		uint32_t instance_count{0}; // 0 draws the built in triangle, otherwise each draw is an instanced quad grid
+		bool gpu_culling{false};    // instances are frustum culled by compute and drawn with drawIndexedIndirectCount
+		float view_scale{1.0f};     // zooms instanced scene, above 1 pushes instances out of view
+		bool bindless{false};       // draws find their resources through the bindless heap by handles in push constants
+		render_path rendering{render_path::dynamic};
+		std::string device{};       // index or part of name of physical device to use, empty picks highest scoring one
+		std::filesystem::path capability_cache_path{"device_capabilities.txt"}; // empty keeps capabilities in memory only
+		std::filesystem::path pipeline_cache_path{"pipeline_cache.bin"}; // empty keeps cache in memory only
+		bool hot_reload{false};     // rebuild shaders and their pipelines when GLSL sources change
+		std::filesystem::path startup_trace_path{}; // Chrome trace of startup up to first frame with draws, empty records nothing
+
+		// Present modes to try, in order of preference. FIFO is always the last resort.
+		[[nodiscard]] auto present_modes() const -> std::vector<vk::PresentModeKHR>;
+		[[nodiscard]] auto max_frames_in_flight() const -> uint32_t;
+
+		// Consumes recognised options, returns remaining arguments
+		// --profile <balanced|low-latency|max-throughput|power-saving>
+		// --frames-in-flight <N>
+		// --record-mode <per-frame|cached>
+		// --record-threads <N>
+		// --draws <N>
+		// --instances <N>
+		// --gpu-culling
+		// --view-scale <F>
+		// --bindless
+		// --render-path <render-pass|dynamic>
+		// --device <index|name>
+		// --capability-cache <file>
+		// --no-capability-cache
+		// --pipeline-cache <file>
+		// --no-pipeline-cache
+		// --hot-reload
+		// --startup-trace <file>
+		static auto from_command_line(const std::vector<std::string_view> &args)
+			-> std::tuple<render_settings, std::vector<std::string_view>>;
+	};
+
+	[[nodiscard]] auto to_string(frame_profile profile) -> std::string_view;
+	[[nodiscard]] auto to_frame_profile(std::string_view name) -> frame_profile;
+	[[nodiscard]] auto to_string(record_mode mode) -> std::string_view;
+	[[nodiscard]] auto to_record_mode(std::string_view name) -> record_mode;
+	[[nodiscard]] auto to_string(render_path path) -> std::string_view;
+	[[nodiscard]] auto to_render_path(std::string_view name) -> render_path;
+}
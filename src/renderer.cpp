@@ -2,7 +2,21 @@
 
 #include "vk/instance.hpp"
 #include "vk/devices.hpp"
+#include "vk/memory_allocator.hpp"
+#include "vk/upload_service.hpp"
+#include "vk/uniform_ring.hpp"
+#include "vk/compute_queue.hpp"
+#include "vk/bindless_heap.hpp"
+#include "vk/barrier_batch.hpp"
 #include "vk/swap_chain.hpp"
+#include "vk/offscreen_target.hpp"
+#include "vk/gpu_timer.hpp"
+#include "vk/timeline.hpp"
+#include "vk/pipeline_cache.hpp"
+#include "thread_pool.hpp"
+#include "startup_trace.hpp"
+#include "shader_watcher.hpp"
+#include "scene.hpp"
 #include "vk/pipeline.hpp"
 
 using namespace vulkan_eg;
@@ -10,126 +24,340 @@ using namespace std::string_literals;
 
 namespace 
 {
-	constexpr auto max_frames_in_flight = 2;
+	using timer = std::chrono::steady_clock;
 
-	auto get_window_name(HWND handle) -> std::string
+	// matches draw_constants in simple_shader.vert
+	struct draw_constants
 	{
-		auto len = static_cast<size_t>(GetWindowTextLengthA(handle)) + 1;
-		auto name{""s};
-		name.resize(len);
-		auto result = GetWindowTextA(handle, &name[0], static_cast<int>(len));
-		name.resize(len - 1);
+		glm::mat4 transform;
+		glm::vec4 tint;
+	};
 
-		return name;
-	}
+	// matches draw_handles in simple_bindless.vert
+	struct draw_handles
+	{
+		uint32_t constants_buffer;
+		uint32_t constants_index;  // in vec4s
+	};
+
+	// matches cull_params in culling.comp
+	struct cull_params
+	{
+		glm::mat4 view;
+		uint32_t instance_count;
+		uint32_t index_count;
+	};
+
+	constexpr auto cull_group_size = 64u; // local_size_x in culling.comp
 
-	auto read_file(const std::filesystem::path &filename) -> std::vector<uint32_t>
+	auto align_up(vk::DeviceSize value, vk::DeviceSize alignment) -> vk::DeviceSize
 	{
-		auto file = std::ifstream(filename, std::ios::ate | std::ios::binary);
+		return (value + alignment - 1) / alignment * alignment;
+	}
 
-		if (not file.is_open())
+	// dynamic rendering is core in 1.3, older devices keep using render passes
+	auto pick_render_path(render_path wanted, const vkw::devices &vkw_devices) -> render_path
+	{
+		if (wanted == render_path::dynamic and not vkw_devices.get_features_13().dynamicRendering)
 		{
-			throw std::runtime_error("failed to open file!");
+			std::cerr << "Device has no dynamic rendering, using render passes\n";
+			return render_path::render_pass;
 		}
+		return wanted;
+	}
 
-		auto file_size = file.tellg();
-		auto buffer = std::vector<uint32_t>(file_size);
-		
-		file.seekg(0);
-		file.read(reinterpret_cast<char *>(buffer.data()), file_size);
-
-		file.close();
+	constexpr auto color_range = vk::ImageSubresourceRange
+	{
+		.aspectMask = vk::ImageAspectFlagBits::eColor,
+		.baseMipLevel = 0,
+		.levelCount = 1,
+		.baseArrayLayer = 0,
+		.layerCount = 1
+	};
 
-		return buffer;
+	auto elapsed_ms(timer::time_point start) -> double
+	{
+		return std::chrono::duration<double, std::milli>(timer::now() - start).count();
 	}
 
-	auto create_shader_module(vk::Device &device, const std::vector<uint32_t> &shader_code) -> vk::ShaderModule
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+	auto get_window_name(HWND handle) -> std::string
 	{
-		auto createInfo = vk::ShaderModuleCreateInfo
-		{
-			.codeSize = shader_code.size(),
-			.pCode = shader_code.data()
-		};
+		auto len = static_cast<size_t>(GetWindowTextLengthA(handle)) + 1;
+		auto name{""s};
+		name.resize(len);
+		auto result = GetWindowTextA(handle, &name[0], static_cast<int>(len));
+		name.resize(len - 1);
 
-		return device.createShaderModule(createInfo);
+		return name;
 	}
+#endif
 }
 
-renderer::renderer(HWND windowHandle)
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+renderer::renderer(HWND windowHandle, const render_settings &settings)
+	: settings{ settings }, frames_in_flight{ settings.max_frames_in_flight() }
 {
+	if (not settings.startup_trace_path.empty())
+	{
+		begin_trace();
+	}
+	auto scope = trace_scope("renderer::renderer");
 	auto name = get_window_name(windowHandle);
 
 	vk_instance = std::make_unique<vkw::instance>(name, name, VK_MAKE_VERSION(0, 0, 1), windowHandle);
-	vk_devices = std::make_unique<vkw::devices>(vk_instance.get());
-	vk_swapchain = std::make_unique<vkw::swap_chain>(vk_instance.get(), vk_devices.get());
-
-	std::tie(instance, surface) = vk_instance->get();
-	device = vk_devices->get_device();
+	vk_devices = std::make_unique<vkw::devices>(vk_instance.get(), vkw::device_selection
+	{
+		.preferred = settings.device,
+		.capability_cache_path = settings.capability_cache_path
+	});
+	vk_allocator = std::make_unique<vkw::memory_allocator>(vk_devices.get(), frames_in_flight);
+	this->settings.rendering = pick_render_path(settings.rendering, *vk_devices);
+	vk_swapchain = std::make_unique<vkw::swap_chain>(vk_instance.get(), vk_devices.get(), settings.present_modes(), frames_in_flight,
+	                                                 this->settings.rendering == render_path::render_pass);
+	vk_target = vk_swapchain.get();
+
+	create_renderer_objects();
+}
+#endif
 
-	create_graphics_pipeline();
+renderer::renderer(vk::Extent2D extent, const render_settings &settings)
+	: settings{ settings }, frames_in_flight{ settings.max_frames_in_flight() }
+{
+	if (not settings.startup_trace_path.empty())
+	{
+		begin_trace();
+	}
+	auto scope = trace_scope("renderer::renderer");
+	auto name = "vulkan-eg-headless"s;
 
-	create_command_pool();
-	create_command_buffer();
-	create_sync_objects();
+	vk_instance = std::make_unique<vkw::instance>(name, name, VK_MAKE_VERSION(0, 0, 1));
+	vk_devices = std::make_unique<vkw::devices>(vk_instance.get(), vkw::device_selection
+	{
+		.preferred = settings.device,
+		.capability_cache_path = settings.capability_cache_path
+	});
+	vk_allocator = std::make_unique<vkw::memory_allocator>(vk_devices.get(), frames_in_flight);
+	this->settings.rendering = pick_render_path(settings.rendering, *vk_devices);
+	// one image per frame in flight, so frames never wait on each other's target
+	vk_offscreen = std::make_unique<vkw::offscreen_target>(vk_devices.get(), vk_allocator.get(), extent, frames_in_flight,
+	                                                       vk::Format::eR8G8B8A8Unorm, this->settings.rendering == render_path::render_pass);
+	vk_target = vk_offscreen.get();
+
+	create_renderer_objects();
 }
 
 renderer::~renderer()
 {
+	// closed before any frame drew, trace still shows how far startup got
+	write_startup_trace();
+
+	// uploads queued since last frame still reference scene buffers
+	vk_uploads->flush();
 	device.waitIdle();
 
-	for(auto&& [image_available_semaphore, render_finished_semaphore, in_flight_fence]
-	         : ranges::views::zip(image_available_semaphores, render_finished_semaphores, in_flight_fences))
+	for (auto &image_available_semaphore : image_available_semaphores)
 	{
-		device.destroyFence(in_flight_fence);
-		device.destroySemaphore(render_finished_semaphore);
 		device.destroySemaphore(image_available_semaphore);
 	}
 
-	device.destroyCommandPool(command_pool);
+	frame_timeline.reset();
+
+	for (auto &frame_pools : parallel_pools)
+	{
+		for (auto &secondary : frame_pools)
+		{
+			device.destroyCommandPool(secondary.pool);
+		}
+	}
 
-	device.destroyPipeline(graphics_pipeline);
-	device.destroyPipelineLayout(pipeline_layout);
+	device.destroyCommandPool(command_pool);
+	device.destroyDescriptorPool(descriptor_pool);
+
+	cull_pipeline.reset();
+	destroy_buffer(draw_counts);
+	destroy_buffer(draw_commands);
+	destroy_buffer(instance_colors);
+	destroy_buffer(instance_transforms);
+	destroy_buffer(mesh_indices);
+	destroy_buffer(mesh_vertices);
+
+	// finish any compile still running before its factory goes away
+	compile_threads.reset();
+	shader_watch.reset();
+	reloaded_pipeline.reset();
+	retired_pipelines.clear();
+	graphics_pipeline = {};
+	vk_pipelines.reset();
 }
 
 void renderer::draw_frame()
 {
+	// trace ends with first frame that had draws, written here once that frame's scope has closed
+	if (drew_frame and is_tracing())
+	{
+		write_startup_trace();
+	}
+	auto scope = trace_scope("renderer::draw_frame");
+
+	if (vk_swapchain and swap_chain_dirty)
+	{
+		recreate_swap_chain();
+	}
+	if (swap_chain_minimized)
+	{
+		// nothing to present to, wait for resize to be called
+		return;
+	}
+
 	auto &&[graphics_queue, present_queue] = vk_devices->get_queues();
-	auto swap_chain = vk_swapchain->get();
-	auto in_flight_fence = in_flight_fences.at(current_frame);
-	auto image_available_semaphore = image_available_semaphores.at(current_frame);
-	auto render_finished_semaphore = render_finished_semaphores.at(current_frame);
 	auto command_buffer = command_buffers.at(current_frame);
 
-	auto res_fence = device.waitForFences(in_flight_fence, true, UINT64_MAX);
-	
-	auto [result, image_index] = device.acquireNextImageKHR(swap_chain, UINT64_MAX, image_available_semaphore, VK_NULL_HANDLE);
-	if (result == vk::Result::eErrorOutOfDateKHR
-	    or result == vk::Result::eSuboptimalKHR)
+	// wait for the frame that last used this frame's resources
+	auto stage_start = timer::now();
+	if (frame_number >= frames_in_flight)
 	{
-		//recreate_swap_chain(graphics_queue, image_available_semaphore);
-		return;
+		frame_timeline->wait(frame_number + 1 - frames_in_flight);
+	}
+	timings.wait_frame = elapsed_ms(stage_start);
+
+	collect_gpu_timings();
+	vk_allocator->begin_frame(current_frame);
+	vk_uniforms->begin_frame(current_frame);
+	write_draw_constants();
+	update_pipelines();
+	reload_shaders();
+	if (vk_swapchain)
+	{
+		vk_swapchain->release_retired(completed_frame());
+	}
+
+	// Offscreen target has an image per frame in flight, nothing to acquire
+	auto image_index = current_frame;
+	auto image_available_semaphore = vk::Semaphore{};
+	auto render_finished_semaphore = vk::Semaphore{};
+	stage_start = timer::now();
+	if (vk_swapchain)
+	{
+		image_available_semaphore = image_available_semaphores.at(current_frame);
+		auto result = vk::Result::eErrorOutOfDateKHR;
+		try
+		{
+			auto acquired = device.acquireNextImageKHR(vk_swapchain->get(), UINT64_MAX, image_available_semaphore, VK_NULL_HANDLE);
+			result = acquired.result;
+			image_index = acquired.value;
+		}
+		catch (vk::OutOfDateKHRError &)
+		{}
+
+		if (result == vk::Result::eErrorOutOfDateKHR)
+		{
+			// Nothing was acquired, semaphore is untouched so frame can just be skipped
+			swap_chain_dirty = true;
+			return;
+		}
+
+		// Suboptimal still acquired an image, so it's rendered and presented before recreating
+		swap_chain_dirty = (result == vk::Result::eSuboptimalKHR);
+
+		// Per image, as present may still be waiting on it when this frame slot comes around again
+		render_finished_semaphore = vk_swapchain->render_finished(image_index);
 	}
+	timings.acquire = elapsed_ms(stage_start);
 
-	device.resetFences(in_flight_fence);
+	stage_start = timer::now();
+	if (settings.recording == record_mode::cached)
+	{
+		command_buffer = get_cached_command_buffer(image_index);
+	}
+	else
+	{
+		command_buffer.reset();
+		record_command_buffer(command_buffer, image_index);
+	}
+	timings.record = elapsed_ms(stage_start);
+
+	// Frame signals its number on the timeline. 
+	// Binary semaphores are still needed for acquire/present, their values are ignored.
+	auto signal_value = frame_number + 1;
+	auto wait_semaphores = std::vector<vk::Semaphore>{};
+	auto wait_stages = std::vector<vk::PipelineStageFlags>{};
+	auto wait_values = std::vector<uint64_t>{};
+	auto signal_semaphores = std::vector{ frame_timeline->get() };
+	auto signal_values = std::vector{ signal_value };
+
+	// copies queued since last frame go out on the transfer queue, frame only waits for them on GPU.
+	// Every frame waits on latest value, a wait only orders the batch it's submitted with.
+	auto upload_value = vk_uploads->flush();
+	if (settings.gpu_culling)
+	{
+		dispatch_culling(upload_value);
+	}
+	if (upload_value > 0)
+	{
+		wait_semaphores.push_back(vk_uploads->get_timeline().get());
+		wait_stages.push_back(vk::PipelineStageFlagBits::eAllCommands);
+		wait_values.push_back(upload_value);
+	}
 
-	command_buffer.reset();
-	record_command_buffer(command_buffer, image_index);
+	// compute results this frame consumes, regions compute writes are free to reuse as the CPU
+	// frame_timeline wait above already saw the frame that last read them complete
+	auto compute_value = vk_compute->submitted_value();
+	if (compute_value > 0)
+	{
+		wait_semaphores.push_back(vk_compute->get_timeline().get());
+		wait_stages.push_back(vk::PipelineStageFlagBits::eDrawIndirect
+		                    | vk::PipelineStageFlagBits::eVertexInput
+		                    | vk::PipelineStageFlagBits::eVertexShader
+		                    | vk::PipelineStageFlagBits::eFragmentShader);
+		wait_values.push_back(compute_value);
+	}
+
+	if (vk_swapchain)
+	{
+		wait_semaphores.push_back(image_available_semaphore);
+		wait_stages.push_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+		wait_values.push_back(0);
+
+		signal_semaphores.push_back(render_finished_semaphore);
+		signal_values.push_back(0);
+	}
+
+	auto timeline_si = vk::TimelineSemaphoreSubmitInfo
+	{
+		.waitSemaphoreValueCount = static_cast<uint32_t>(wait_values.size()),
+		.pWaitSemaphoreValues = wait_values.data(),
+		.signalSemaphoreValueCount = static_cast<uint32_t>(signal_values.size()),
+		.pSignalSemaphoreValues = signal_values.data()
+	};
 
-	auto wait_stages = vk::PipelineStageFlags{ vk::PipelineStageFlagBits::eColorAttachmentOutput };
 	auto submit_ci = vk::SubmitInfo
 	{
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &image_available_semaphore,
-		.pWaitDstStageMask = &wait_stages,
+		.pNext = &timeline_si,
+		.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size()),
+		.pWaitSemaphores = wait_semaphores.data(),
+		.pWaitDstStageMask = wait_stages.data(),
 		.commandBufferCount = 1,
 		.pCommandBuffers = &command_buffer,
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = &render_finished_semaphore
+		.signalSemaphoreCount = static_cast<uint32_t>(signal_semaphores.size()),
+		.pSignalSemaphores = signal_semaphores.data()
 	};
 
-	graphics_queue.submit({submit_ci}, in_flight_fence);
+	stage_start = timer::now();
+	graphics_queue.submit({submit_ci});
+	timings.submit = elapsed_ms(stage_start);
 
-	auto swap_chains = std::vector{ swap_chain };
+	frame_number = signal_value;
+	drew_frame = drew_frame or startup.pipelines_ready;
+
+	if (not vk_swapchain)
+	{
+		timings.present = 0.0;
+		current_frame = (current_frame + 1) % frames_in_flight;
+		return;
+	}
+
+	auto swap_chains = std::vector{ vk_swapchain->get() };
 	auto present_info = vk::PresentInfoKHR
 	{
 		.waitSemaphoreCount = 1,
@@ -139,263 +367,1041 @@ void renderer::draw_frame()
 		.pImageIndices = &image_index
 	};
 
-	result = present_queue.presentKHR(present_info);
+	stage_start = timer::now();
+	auto result = vk::Result::eErrorOutOfDateKHR;
+	try
+	{
+		result = present_queue.presentKHR(present_info);
+	}
+	catch (vk::OutOfDateKHRError &)
+	{}
+	timings.present = elapsed_ms(stage_start);
 
-	current_frame = (current_frame + 1) % max_frames_in_flight;
+	if (result == vk::Result::eErrorOutOfDateKHR
+	    or result == vk::Result::eSuboptimalKHR)
+	{
+		swap_chain_dirty = true;
+	}
+
+	current_frame = (current_frame + 1) % frames_in_flight;
 }
 
-void renderer::create_graphics_pipeline()
+void renderer::resize()
+{
+	swap_chain_dirty = true;
+	swap_chain_minimized = false;
+}
+
+void renderer::invalidate_commands()
+{
+	commands_generation++;
+}
+
+void renderer::wait_for_pipelines()
+{
+	auto scope = trace_scope("renderer::wait_for_pipelines");
+	graphics_pipeline.wait();
+	update_pipelines();
+}
+
+auto renderer::get_frame_timings() const -> const frame_timings &
+{
+	return timings;
+}
+
+auto renderer::get_gpu_timings() const -> const gpu_timings &
+{
+	return gpu_frame_timings;
+}
+
+auto renderer::get_startup_timings() const -> const startup_timings &
+{
+	return startup;
+}
+
+auto renderer::get_memory_stats() const -> vkw::memory_stats
+{
+	return vk_allocator->get_stats();
+}
+
+auto renderer::get_render_path() const -> render_path
+{
+	return settings.rendering;
+}
+
+auto renderer::get_device_name() const -> std::string
+{
+	return vk_devices->get_choice().name;
+}
+
+auto renderer::get_device_choice() const -> const vkw::device_choice &
 {
-	auto vert_shader_file = read_file("shaders/simple_shader.vert.spv");
-	auto frag_shader_file = read_file("shaders/simple_shader.frag.spv");
+	return vk_devices->get_choice();
+}
 
-	auto vert_shader = create_shader_module(device, vert_shader_file);
-	auto frag_shader = create_shader_module(device, frag_shader_file);
+void renderer::create_renderer_objects()
+{
+	auto scope = trace_scope("renderer::create_renderer_objects");
+	std::tie(instance, surface) = vk_instance->get();
+	device = vk_devices->get_device();
 
-	auto vert_shdr_ci = vk::PipelineShaderStageCreateInfo
+	vk_uploads = std::make_unique<vkw::upload_service>(vk_devices.get(), vk_allocator.get());
+	vk_compute = std::make_unique<vkw::compute_queue>(vk_devices.get());
+	target_barriers = std::make_unique<vkw::barrier_batch>(vk_devices.get());
+	// bindless shaders read draw constants through the heap, as a storage buffer
+	auto uniforms_usage = settings.bindless ? vk::BufferUsageFlags{ vk::BufferUsageFlagBits::eStorageBuffer } : vk::BufferUsageFlags{};
+	vk_uniforms = std::make_unique<vkw::uniform_ring>(vk_devices.get(), vk_allocator.get(), frames_in_flight, 
+	                                                  settings.draw_count, sizeof(draw_constants), uniforms_usage);
+	if (settings.bindless)
 	{
-		.stage = vk::ShaderStageFlagBits::eVertex,
-		.module = vert_shader,
-		.pName = "main"
-	};
+		vk_bindless = std::make_unique<vkw::bindless_heap>(vk_devices.get());
+		uniforms_handle = vk_bindless->add_buffer(vk_uniforms->get_buffer());
+	}
+	create_descriptor_pool();
+	create_scene();
+	create_culling();
 
-	auto frag_shdr_ci = vk::PipelineShaderStageCreateInfo
 	{
-		.stage = vk::ShaderStageFlagBits::eFragment,
-		.module = frag_shader,
-		.pName = "main"
-	};
+		auto cache_scope = trace_scope("renderer: load pipeline cache");
+		vk_pipeline_cache = std::make_unique<vkw::pipeline_cache>(vk_devices.get(), settings.pipeline_cache_path);
+	}
+	startup.pipeline_cache_warm = vk_pipeline_cache->is_warm();
 
-	auto shader_stages = std::vector
+	// Compiling off the frame thread, so constructor and first frames don't wait on it
+	auto compile_thread_count = std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u);
+	compile_threads = std::make_unique<thread_pool>(compile_thread_count);
+	vk_pipelines = std::make_unique<vkw::pipeline_factory>(device, vk_pipeline_cache.get(), compile_threads.get());
+
+	create_graphics_pipeline();
+
+	if (settings.hot_reload)
 	{
-		vert_shdr_ci, 
-		frag_shdr_ci
-	};
+		shader_watch = shader_watcher::from_build();
+		if (not shader_watch)
+		{
+			std::cerr << "Hot reload: build has no shader sources to watch\n";
+		}
+	}
+
+	create_command_pool();
+	create_command_buffer();
+	create_parallel_recording();
+	create_sync_objects();
+
+	vk_gpu_timer = std::make_unique<vkw::gpu_timer>(vk_devices.get(), frames_in_flight);
+}
 
-	auto vert_input_ci = vk::PipelineVertexInputStateCreateInfo
+void renderer::create_graphics_pipeline()
+{
+	auto scope = trace_scope("renderer::create_graphics_pipeline");
+	auto is_instanced = settings.instance_count > 0;
+	auto vertex_shader = settings.bindless ? (is_instanced ? "shaders/instanced_bindless.vert.spv" : "shaders/simple_bindless.vert.spv")
+	                                       : (is_instanced ? "shaders/instanced.vert.spv" : "shaders/simple_shader.vert.spv");
+	auto desc = vkw::pipeline_descriptor
 	{
-		.vertexBindingDescriptionCount = 0,
-		.vertexAttributeDescriptionCount = 0
+		.shaders = {
+			{ vk::ShaderStageFlagBits::eVertex, vkw::shader_code::load(vertex_shader, settings.hot_reload) },
+			{ vk::ShaderStageFlagBits::eFragment, vkw::shader_code::load("shaders/simple_shader.frag.spv", settings.hot_reload) },
+		},
+		.topology = vk::PrimitiveTopology::eTriangleList,
+		.polygon_mode = vk::PolygonMode::eFill,
+		.cull_mode = vk::CullModeFlagBits::eBack,
+		.front_face = vk::FrontFace::eClockwise,
+		.color_formats = { vk_target->get_format() },
+		.render_pass = vk_target->get_render_pass(),
 	};
 
-	auto inpt_asmbly_ci = vk::PipelineInputAssemblyStateCreateInfo
+	if (settings.bindless)
 	{
-		.topology = vk::PrimitiveTopology::eTriangleList,
-		.primitiveRestartEnable = false
+		desc.external_sets = { {0, vk_bindless->get_layout()} };
+	}
+	else
+	{
+		desc.dynamic_buffers = { {0, 0} };
+	}
+
+	if (is_instanced)
+	{
+		// matches create_scene's buffers: vertices, then each per instance array in its own buffer
+		desc.vertex_streams = {
+			{ .locations = { 0 }, .input_rate = vk::VertexInputRate::eVertex },
+			{ .locations = { 1 }, .input_rate = vk::VertexInputRate::eInstance },
+			{ .locations = { 2 }, .input_rate = vk::VertexInputRate::eInstance },
+		};
+		desc.vertex_formats = { { 2, vk::Format::eR8G8B8A8Unorm } };
+	}
+
+	graphics_pipeline = vk_pipelines->get_async(desc);
+	graphics_pipeline_desc = std::move(desc);
+}
+
+void renderer::create_command_pool()
+{
+	auto scope = trace_scope("renderer::create_command_pool");
+	auto queue_family_indices = vk_devices->get_queue_family();
+
+	auto command_pool_ci = vk::CommandPoolCreateInfo
+	{
+		.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		.queueFamilyIndex = queue_family_indices.graphics_family.value()
 	};
 
-	auto viewport_ci = vk::PipelineViewportStateCreateInfo
+	command_pool = device.createCommandPool(command_pool_ci);
+}
+
+void renderer::create_command_buffer()
+{
+	auto scope = trace_scope("renderer::create_command_buffer");
+	auto cmd_buffer_alloc_info = vk::CommandBufferAllocateInfo
 	{
-		.viewportCount = 1,
-		.scissorCount = 1
+		.commandPool = command_pool,
+		.level = vk::CommandBufferLevel::ePrimary,
+		.commandBufferCount = frames_in_flight
 	};
 
-	auto rasterizer_ci = vk::PipelineRasterizationStateCreateInfo
+	command_buffers = device.allocateCommandBuffers(cmd_buffer_alloc_info);
+}
+
+void renderer::create_parallel_recording()
+{
+	auto scope = trace_scope("renderer::create_parallel_recording");
+	if (settings.record_threads == 0)
+	{
+		return;
+	}
+
+	recording_threads = std::make_unique<thread_pool>(settings.record_threads);
+
+	// Pool per worker per frame, so workers never share a pool 
+	// and a frame's pools can be reset wholesale once that frame has completed
+	auto queue_family_indices = vk_devices->get_queue_family();
+	parallel_pools.resize(frames_in_flight);
+	for (auto &frame_pools : parallel_pools)
 	{
-		.depthClampEnable = false,
-		.rasterizerDiscardEnable = false,
-		.polygonMode = vk::PolygonMode::eFill,
-		.cullMode = vk::CullModeFlagBits::eBack,
-		.frontFace = vk::FrontFace::eClockwise,
-		.depthBiasEnable = false,
-		.lineWidth = 1.0f
+		frame_pools.resize(settings.record_threads);
+		for (auto &secondary : frame_pools)
+		{
+			auto command_pool_ci = vk::CommandPoolCreateInfo
+			{
+				.flags = vk::CommandPoolCreateFlagBits::eTransient,
+				.queueFamilyIndex = queue_family_indices.graphics_family.value()
+			};
+			secondary.pool = device.createCommandPool(command_pool_ci);
+
+			auto cmd_buffer_alloc_info = vk::CommandBufferAllocateInfo
+			{
+				.commandPool = secondary.pool,
+				.level = vk::CommandBufferLevel::eSecondary,
+				.commandBufferCount = 1
+			};
+			secondary.buffer = device.allocateCommandBuffers(cmd_buffer_alloc_info).front();
+		}
+	}
+}
+
+auto renderer::get_cached_command_buffer(uint32_t image_index) -> vk::CommandBuffer
+{
+	// Draw constants live in the frame's region of the uniform ring, so a buffer is only valid
+	// for the frame slot it was recorded in. Offsets within the region repeat every frame.
+	auto cached_count = vk_target->image_count() * frames_in_flight;
+	if (cached_commands.size() < cached_count)
+	{
+		auto cmd_buffer_alloc_info = vk::CommandBufferAllocateInfo
+		{
+			.commandPool = command_pool,
+			.level = vk::CommandBufferLevel::ePrimary,
+			.commandBufferCount = static_cast<uint32_t>(cached_count - cached_commands.size())
+		};
+
+		for (auto &cmd_buffer : device.allocateCommandBuffers(cmd_buffer_alloc_info))
+		{
+			cached_commands.push_back({ .buffer = cmd_buffer });
+		}
+	}
+
+	auto &cached = cached_commands.at(image_index * frames_in_flight + current_frame);
+	if (cached.generation != commands_generation)
+	{
+		// an earlier frame may still be executing it
+		frame_timeline->wait(cached.last_used_frame);
+
+		cached.buffer.reset();
+		record_command_buffer(cached.buffer, image_index);
+		cached.generation = commands_generation;
+	}
+
+	cached.last_used_frame = frame_number + 1;
+	return cached.buffer;
+}
+
+void renderer::record_command_buffer(vk::CommandBuffer &cmd_buffer, uint32_t image_index)
+{
+	// cached buffers get submitted again while earlier submissions may still be executing
+	auto is_cached = (settings.recording == record_mode::cached);
+	auto cmd_buff_begin_info = vk::CommandBufferBeginInfo
+	{
+		.flags = is_cached ? vk::CommandBufferUsageFlagBits::eSimultaneousUse 
+		                   : vk::CommandBufferUsageFlags{}
 	};
+	auto result = cmd_buffer.begin(&cmd_buff_begin_info);
+	if (result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("failed to being recording command buffer.");
+	}
+
+	// re-submitted buffers would overwrite each other's queries, so only per frame recording is timed
+	vk_gpu_timer->begin_frame(cmd_buffer, current_frame, not is_cached);
+	auto render_pass_scope = vk_gpu_timer->begin_scope(cmd_buffer, "render_pass");
+
+	// Cached buffers outlive the per frame pools, so they're always recorded inline
+	// Draws wait for their pipeline to finish compiling, render pass still clears the target meanwhile
+	auto has_draws = startup.pipelines_ready and settings.draw_count > 0;
+	auto is_parallel = recording_threads and not is_cached and has_draws;
+	if (is_parallel)
+	{
+		begin_target(cmd_buffer, image_index, vk::SubpassContents::eSecondaryCommandBuffers);
+		record_parallel(cmd_buffer, image_index);
+	}
+	else
+	{
+		begin_target(cmd_buffer, image_index, vk::SubpassContents::eInline);
+
+		if (has_draws)
+		{
+			auto draw_scope = vk_gpu_timer->begin_scope(cmd_buffer, "triangles");
+			record_draws(cmd_buffer, 0, settings.draw_count);
+			vk_gpu_timer->end_scope(cmd_buffer, draw_scope);
+		}
+	}
+	end_target(cmd_buffer, image_index);
+	vk_gpu_timer->end_scope(cmd_buffer, render_pass_scope);
+
+	cmd_buffer.end();
+}
 
-	auto multisample_ci = vk::PipelineMultisampleStateCreateInfo
+void renderer::begin_target(vk::CommandBuffer &cmd_buffer, uint32_t image_index, vk::SubpassContents contents)
+{
+	auto clear_color = vk::ClearValue
+	{
+		.color = std::array{0.0f, 0.0f, 0.0f, 1.0f}
+	};
+	auto render_area = vk::Rect2D
 	{
-		.rasterizationSamples = vk::SampleCountFlagBits::e1,
-		.sampleShadingEnable = false
+		.offset = {0, 0},
+		.extent = vk_target->get_extent()
 	};
 
-	auto clr_blend_attch_st = vk::PipelineColorBlendAttachmentState
+	if (settings.rendering == render_path::render_pass)
+	{
+		auto render_pass_begin_info = vk::RenderPassBeginInfo
+		{
+			.renderPass = vk_target->get_render_pass(),
+			.framebuffer = vk_target->frame_buffer(image_index),
+			.renderArea = render_area,
+			.clearValueCount = 1,
+			.pClearValues = &clear_color
+		};
+		cmd_buffer.beginRenderPass(render_pass_begin_info, contents);
+		return;
+	}
+
+	// What the render pass's initial layout and external dependency did.
+	// Image acquire is waited on at color output, so the transition has to come after that stage.
+	// Old contents are cleared anyway.
+	auto image = vk_target->image(image_index);
+	target_barriers->set_state(image,
+	{
+		.stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+		.layout = vk_target->final_layout()
+	});
+	target_barriers->use_image(image, color_range,
+	{
+		.stages = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+		.access = vk::AccessFlagBits2::eColorAttachmentWrite,
+		.layout = vk::ImageLayout::eColorAttachmentOptimal
+	}, true);
+	target_barriers->flush(cmd_buffer);
+
+	auto color_attachment = vk::RenderingAttachmentInfo
+	{
+		.imageView = vk_target->image_view(image_index),
+		.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+		.loadOp = vk::AttachmentLoadOp::eClear,
+		.storeOp = vk::AttachmentStoreOp::eStore,
+		.clearValue = clear_color
+	};
+	auto rendering_info = vk::RenderingInfo
 	{
-		.blendEnable = false,
-		.colorWriteMask = vk::ColorComponentFlagBits::eR
-		                | vk::ColorComponentFlagBits::eG
-		                | vk::ColorComponentFlagBits::eB
-		                | vk::ColorComponentFlagBits::eA
+		.flags = contents == vk::SubpassContents::eSecondaryCommandBuffers ? vk::RenderingFlagBits::eContentsSecondaryCommandBuffers
+		                                                                   : vk::RenderingFlags{},
+		.renderArea = render_area,
+		.layerCount = 1,
+		.colorAttachmentCount = 1,
+		.pColorAttachments = &color_attachment
 	};
+	cmd_buffer.beginRendering(rendering_info);
+}
 
-	auto color_blend_ci = vk::PipelineColorBlendStateCreateInfo
+void renderer::end_target(vk::CommandBuffer &cmd_buffer, uint32_t image_index)
+{
+	if (settings.rendering == render_path::render_pass)
 	{
-		.logicOpEnable = false,
-		.logicOp = vk::LogicOp::eCopy,
-		.attachmentCount = 1,
-		.pAttachments = &clr_blend_attch_st,
-		.blendConstants = std::array{0.0f, 0.0f, 0.0f, 0.0f}
+		cmd_buffer.endRenderPass();
+		return;
+	}
+
+	cmd_buffer.endRendering();
+
+	// render pass's final layout, present and readback are ordered by semaphores and fences after this
+	target_barriers->use_image(vk_target->image(image_index), color_range, { .layout = vk_target->final_layout() });
+	target_barriers->flush(cmd_buffer);
+}
+
+void renderer::record_parallel(vk::CommandBuffer &cmd_buffer, uint32_t image_index)
+{
+	auto &frame_pools = parallel_pools.at(current_frame);
+	auto chunk_size = (settings.draw_count + static_cast<uint32_t>(frame_pools.size()) - 1) / static_cast<uint32_t>(frame_pools.size());
+	// rounding chunk size up can leave fewer chunks than pools, e.g. 5 draws on 4 pools is 3 chunks of 2
+	auto chunk_count = (settings.draw_count + chunk_size - 1) / chunk_size;
+
+	// dynamic rendering has no render pass or frame buffer to inherit, only attachment formats
+	auto is_dynamic = (settings.rendering == render_path::dynamic);
+	auto color_format = vk_target->get_format();
+	auto rendering_inheritance = vk::CommandBufferInheritanceRenderingInfo
+	{
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &color_format,
+		.rasterizationSamples = vk::SampleCountFlagBits::e1
 	};
+	auto inheritance_info = vk::CommandBufferInheritanceInfo
+	{
+		.pNext = is_dynamic ? &rendering_inheritance : nullptr,
+		.renderPass = vk_target->get_render_pass(),
+		.subpass = 0,
+		.framebuffer = is_dynamic ? vk::Framebuffer{} : vk_target->frame_buffer(image_index)
+	};
+
+	auto chunks = std::vector<std::future<void>>{};
+	chunks.reserve(chunk_count);
+	for (auto chunk = 0u; chunk < chunk_count; ++chunk)
+	{
+		auto first_draw = chunk * chunk_size;
+		auto draw_count = std::min(chunk_size, settings.draw_count - first_draw);
 
-	auto dynamic_states_array = std::vector
+		chunks.push_back(recording_threads->submit([&, chunk, first_draw, draw_count]()
+		{
+			auto &secondary = frame_pools.at(chunk);
+
+			// frame has completed, so everything allocated from its pool can be reset at once
+			device.resetCommandPool(secondary.pool);
+
+			auto begin_info = vk::CommandBufferBeginInfo
+			{
+				.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue
+				       | vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+				.pInheritanceInfo = &inheritance_info
+			};
+			secondary.buffer.begin(begin_info);
+			record_draws(secondary.buffer, first_draw, draw_count);
+			secondary.buffer.end();
+		}));
+	}
+
+	// workers reference this frame's locals, so all of them have to finish before anything is rethrown
+	for (auto &chunk : chunks)
+	{
+		chunk.wait();
+	}
+
+	auto secondary_buffers = std::vector<vk::CommandBuffer>{};
+	secondary_buffers.reserve(chunk_count);
+	for (auto &&[chunk, secondary] : ranges::views::zip(chunks, frame_pools))
 	{
-		vk::DynamicState::eViewport,
-		vk::DynamicState::eScissor,
+		chunk.get(); // rethrows anything the worker threw
+		secondary_buffers.push_back(secondary.buffer);
+	}
+
+	cmd_buffer.executeCommands(secondary_buffers);
+}
+
+void renderer::record_draws(vk::CommandBuffer &cmd_buffer, uint32_t first_draw, uint32_t draw_count)
+{
+	auto extent = vk_target->get_extent();
+	auto pipeline = graphics_pipeline.get();
+
+	cmd_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline->get());
+
+	auto viewport = vk::Viewport
+	{
+		.x = 0.0f, 
+		.y = 0.0f,
+		.width = static_cast<float>(extent.width),
+		.height = static_cast<float>(extent.height),
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f
 	};
+	cmd_buffer.setViewport(0, viewport);
 
-	auto dynamic_state = vk::PipelineDynamicStateCreateInfo
+	auto scissor = vk::Rect2D
 	{
-		.dynamicStateCount = static_cast<uint32_t>(dynamic_states_array.size()),
-		.pDynamicStates = dynamic_states_array.data()
+		.offset = {0, 0},
+		.extent = extent
 	};
+	cmd_buffer.setScissor(0, scissor);
+
+	auto is_instanced = settings.instance_count > 0;
+	if (is_instanced)
+	{
+		auto vertex_buffers = std::array{ mesh_vertices.buffer, instance_transforms.buffer, instance_colors.buffer };
+		auto offsets = std::array<vk::DeviceSize, 3>{};
+		cmd_buffer.bindVertexBuffers(0, vertex_buffers, offsets);
+		cmd_buffer.bindIndexBuffer(mesh_indices.buffer, 0, vk::IndexType::eUint16);
+	}
+
+	// heap is the only set, each draw just pushes where its constants are
+	if (vk_bindless)
+	{
+		cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->get_layout(), 0, vk_bindless->get_set(), {});
+	}
+
+	for (auto i = first_draw; i < first_draw + draw_count; ++i)
+	{
+		if (vk_bindless)
+		{
+			auto handles = draw_handles
+			{
+				.constants_buffer = uniforms_handle,
+				.constants_index = draw_offsets.at(i) / static_cast<uint32_t>(sizeof(glm::vec4))
+			};
+			cmd_buffer.pushConstants(pipeline->get_layout(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(handles), &handles);
+		}
+		else if (draw_descriptor_set)
+		{
+			cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline->get_layout(), 0, draw_descriptor_set, draw_offsets.at(i));
+		}
+
+		if (settings.gpu_culling)
+		{
+			// one command per visible instance, CPU cost doesn't depend on scene size
+			cmd_buffer.drawIndexedIndirectCount(draw_commands.buffer, draw_commands_stride * current_frame,
+			                                    draw_counts.buffer, draw_counts_stride * current_frame,
+			                                    settings.instance_count, sizeof(vk::DrawIndexedIndirectCommand));
+		}
+		else if (is_instanced)
+		{
+			cmd_buffer.drawIndexed(mesh_index_count, settings.instance_count, 0, 0, 0);
+		}
+		else
+		{
+			cmd_buffer.draw(3, 1, 0, 0);
+		}
+	}
+}
+
+void renderer::collect_gpu_timings()
+{
+	// frame that last used this slot has completed, its queries can be read without waiting
+	vk_gpu_timer->resolve(current_frame);
+
+	auto &results = vk_gpu_timer->get_results();
+	if (results.empty())
+	{
+		return;
+	}
+
+	gpu_frame_timings.render_pass = std::get<double>(results.front());
+	gpu_frame_timings.draw_scopes.assign(std::next(results.begin()), results.end());
+}
+
+void renderer::update_pipelines()
+{
+	if (startup.pipelines_ready or not graphics_pipeline.is_ready())
+	{
+		return;
+	}
+
+	// rethrows on frame thread if compiling failed
+	startup.pipeline_creation = graphics_pipeline.get()->get_creation_time();
+	startup.pipelines_ready = true;
+	update_draw_descriptors();
+
+	// cached buffers were recorded without the draws
+	invalidate_commands();
+}
+
+void renderer::reload_shaders()
+{
+	// swapped out pipelines live until the frames recorded with them are done, no waitIdle needed
+	while (not retired_pipelines.empty() 
+	       and frame_timeline->is_complete(std::get<uint64_t>(retired_pipelines.front())))
+	{
+		retired_pipelines.pop_front();
+	}
+	while (not retired_descriptor_sets.empty()
+	       and frame_timeline->is_complete(std::get<uint64_t>(retired_descriptor_sets.front())))
+	{
+		device.freeDescriptorSets(descriptor_pool, std::get<vk::DescriptorSet>(retired_descriptor_sets.front()));
+		retired_descriptor_sets.pop_front();
+	}
+
+	if (not shader_watch)
+	{
+		return;
+	}
+
+	auto rebuilt = shader_watch->poll();
+	if (not rebuilt.empty())
+	{
+		// build on a reload still compiling, so its changes aren't lost
+		auto desc = reloaded_pipeline ? reloaded_pipeline->desc : graphics_pipeline_desc;
+		auto changed = false;
+		for (auto &&[stage, code] : desc.shaders)
+		{
+			for (auto &shader : rebuilt)
+			{
+				if (code.get_name() == shader.name)
+				{
+					// read, not mapped, so the next rebuild can replace the file
+					code = vkw::shader_code::read_file(shader.spv, shader.name);
+					changed = true;
+				}
+			}
+		}
+
+		if (changed)
+		{
+			reloaded_pipeline = pending_pipeline
+			{
+				.desc = desc,
+				.handle = vk_pipelines->get_async(desc)
+			};
+		}
+	}
+
+	if (not reloaded_pipeline or not reloaded_pipeline->handle.is_ready())
+	{
+		return;
+	}
+
+	auto reloaded = std::move(*reloaded_pipeline);
+	reloaded_pipeline.reset();
+
+	try
+	{
+		std::ignore = reloaded.handle.get();
+	}
+	catch (const std::exception &err)
+	{
+		// keep drawing with current pipeline
+		std::cerr << std::format("Hot reload: pipeline creation failed: {}\n", err.what());
+		vk_pipelines->erase(reloaded.desc);
+		return;
+	}
+
+	if (reloaded.desc == graphics_pipeline_desc)
+	{
+		return;
+	}
+
+	// frames up to frame_number may still be using current pipeline
+	vk_pipelines->erase(graphics_pipeline_desc);
+	retired_pipelines.emplace_back(frame_number, std::move(graphics_pipeline));
+
+	graphics_pipeline_desc = std::move(reloaded.desc);
+	graphics_pipeline = std::move(reloaded.handle);
+	update_draw_descriptors();
+	invalidate_commands();
+}
+
+void renderer::update_draw_descriptors()
+{
+	// heap's set is bound as is, nothing per pipeline
+	if (settings.bindless)
+	{
+		return;
+	}
+
+	// reloaded shaders usually keep their interface, layout_cache then hands back the same set layout
+	auto &set_layouts = graphics_pipeline.get()->get_set_layouts();
+	auto set_layout = set_layouts.empty() ? vk::DescriptorSetLayout{} : set_layouts.front();
+	if (set_layout == draw_set_layout)
+	{
+		return;
+	}
 
-	auto pipeline_layout_ci = vk::PipelineLayoutCreateInfo
+	// frames up to frame_number may still be using current set
+	if (draw_descriptor_set)
 	{
-		.setLayoutCount = 0,
-		.pushConstantRangeCount = 0
+		retired_descriptor_sets.emplace_back(frame_number, draw_descriptor_set);
+		draw_descriptor_set = nullptr;
+	}
+
+	draw_set_layout = set_layout;
+	if (not draw_set_layout)
+	{
+		return;
+	}
+
+	auto set_alloc_info = vk::DescriptorSetAllocateInfo
+	{
+		.descriptorPool = descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &draw_set_layout
 	};
+	draw_descriptor_set = device.allocateDescriptorSets(set_alloc_info).front();
 
-	auto result = device.createPipelineLayout(&pipeline_layout_ci, nullptr, &pipeline_layout);
-	auto render_pass = vk_swapchain->get_render_pass();
-
-	auto gfx_pipeline_layout_ci = vk::GraphicsPipelineCreateInfo
-	{
-		.stageCount = 2,
-		.pStages = shader_stages.data(),
-		.pVertexInputState = &vert_input_ci,
-		.pInputAssemblyState = &inpt_asmbly_ci,
-		.pViewportState = &viewport_ci,
-		.pRasterizationState = &rasterizer_ci,
-		.pMultisampleState = &multisample_ci,
-		.pColorBlendState = &color_blend_ci,
-		.pDynamicState = &dynamic_state,
-		.layout = pipeline_layout,
-		.renderPass = render_pass,
-		.subpass = 0
+	auto buffer_info = vk_uniforms->descriptor_info();
+	auto write = vk::WriteDescriptorSet
+	{
+		.dstSet = draw_descriptor_set,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = vk::DescriptorType::eUniformBufferDynamic,
+		.pBufferInfo = &buffer_info
 	};
+	device.updateDescriptorSets(write, {});
+}
 
-	std::tie(result, graphics_pipeline) = device.createGraphicsPipeline(nullptr, gfx_pipeline_layout_ci);
-	if (result != vk::Result::eSuccess)
+void renderer::write_draw_constants()
+{
+	// same allocation order every frame, so cached command buffers' offsets stay valid
+	draw_offsets.resize(settings.draw_count);
+	for (auto &offset : draw_offsets)
 	{
-		throw std::runtime_error("Unable to create graphics pipeline");
+		offset = vk_uniforms->push(draw_constants
+		{
+			.transform = make_view_transform(settings.view_scale),
+			.tint = glm::vec4{ 1.0f }
+		});
 	}
+}
+
+void renderer::create_sync_objects()
+{
+	auto scope = trace_scope("renderer::create_sync_objects");
+	frame_timeline = std::make_unique<vkw::timeline>(device);
 
-	device.destroyShaderModule(frag_shader);
-	device.destroyShaderModule(vert_shader);
+	// headless has nothing to acquire or present
+	if (not vk_swapchain)
+	{
+		return;
+	}
+
+	image_available_semaphores.resize(frames_in_flight);
+	for (auto &image_available_semaphore : image_available_semaphores)
+	{
+		image_available_semaphore = device.createSemaphore(vk::SemaphoreCreateInfo{});
+	}
 }
 
-void renderer::create_command_pool()
+void renderer::create_descriptor_pool()
 {
-	auto queue_family_indices = vk_devices->get_queue_family();
+	auto scope = trace_scope("renderer::create_descriptor_pool");
+	// a draw set being replaced by hot reload stays alive until frames in flight using it complete
+	auto draw_sets = frames_in_flight + 1;
+	auto pool_sizes = std::array
+	{
+		vk::DescriptorPoolSize{ .type = vk::DescriptorType::eUniformBufferDynamic, .descriptorCount = draw_sets },
+		// culling: instance transforms, then draw commands and count per frame
+		vk::DescriptorPoolSize{ .type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 1 },
+		vk::DescriptorPoolSize{ .type = vk::DescriptorType::eStorageBufferDynamic, .descriptorCount = 2 },
+	};
 
-	auto command_pool_ci = vk::CommandPoolCreateInfo
+	auto descriptor_pool_ci = vk::DescriptorPoolCreateInfo
 	{
-		.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
-		.queueFamilyIndex = queue_family_indices.graphics_family.value()
+		.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+		.maxSets = draw_sets + 1,
+		.poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+		.pPoolSizes = pool_sizes.data()
 	};
+	descriptor_pool = device.createDescriptorPool(descriptor_pool_ci);
+}
 
-	command_pool = device.createCommandPool(command_pool_ci);
+void renderer::create_scene()
+{
+	auto scope = trace_scope("renderer::create_scene");
+	if (settings.instance_count == 0)
+	{
+		return;
+	}
+
+	auto quad = make_quad();
+	mesh_vertices = create_static_buffer(std::as_bytes(std::span(quad.vertices)), vk::BufferUsageFlagBits::eVertexBuffer);
+	mesh_indices = create_static_buffer(std::as_bytes(std::span(quad.indices)), vk::BufferUsageFlagBits::eIndexBuffer);
+	mesh_index_count = static_cast<uint32_t>(quad.indices.size());
+
+	auto instances = make_grid_instances(settings.instance_count);
+	// also read by culling
+	instance_transforms = create_static_buffer(std::as_bytes(std::span(instances.transforms)),
+	                                           vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+	instance_colors = create_static_buffer(std::as_bytes(std::span(instances.colors)), vk::BufferUsageFlagBits::eVertexBuffer);
 }
 
-void renderer::create_command_buffer()
+auto renderer::create_static_buffer(std::span<const std::byte> data, vk::BufferUsageFlags usage) -> gpu_buffer
 {
-	auto cmd_buffer_alloc_info = vk::CommandBufferAllocateInfo
+	// written on the upload queue, read on graphics
+	auto &families = vk_uploads->sharing_families();
+	auto buffer_ci = vk::BufferCreateInfo
 	{
-		.commandPool = command_pool,
-		.level = vk::CommandBufferLevel::ePrimary,
-		.commandBufferCount = max_frames_in_flight
+		.size = data.size(),
+		.usage = usage | vk::BufferUsageFlagBits::eTransferDst,
+		.sharingMode = families.empty() ? vk::SharingMode::eExclusive : vk::SharingMode::eConcurrent,
+		.queueFamilyIndexCount = static_cast<uint32_t>(families.size()),
+		.pQueueFamilyIndices = families.data()
 	};
 
-	command_buffers = device.allocateCommandBuffers(cmd_buffer_alloc_info);
+	auto out = gpu_buffer{};
+	std::tie(out.buffer, out.memory) = vk_allocator->create_buffer(buffer_ci, vkw::memory_usage::gpu_only);
+	vk_uploads->upload_buffer(out.buffer, 0, data);
+	return out;
 }
 
-void renderer::record_command_buffer(vk::CommandBuffer &cmd_buffer, uint32_t image_index)
+void renderer::destroy_buffer(gpu_buffer &buffer)
 {
-	auto extent = vk_swapchain->get_extent();
-	auto cmd_buff_begin_info = vk::CommandBufferBeginInfo{};
-	auto result = cmd_buffer.begin(&cmd_buff_begin_info);
-	if (result != vk::Result::eSuccess)
+	if (not buffer.buffer)
 	{
-		throw std::runtime_error("failed to being recording command buffer.");
+		return;
 	}
 
-	auto clear_color = vk::ClearValue
+	vk_allocator->destroy_buffer(buffer.buffer, buffer.memory);
+	buffer = {};
+}
+
+void renderer::create_culling()
+{
+	auto scope = trace_scope("renderer::create_culling");
+	if (not settings.gpu_culling)
 	{
-		.color = std::array{0.0f, 0.0f, 0.0f, 1.0f}
+		return;
+	}
+
+	if (settings.instance_count == 0)
+	{
+		throw std::runtime_error("GPU culling needs an instanced scene, set an instance count.");
+	}
+	if (not vk_devices->get_features_12().drawIndirectCount or not vk_devices->get_features().drawIndirectFirstInstance)
+	{
+		throw std::runtime_error("GPU culling needs drawIndirectCount and drawIndirectFirstInstance.");
+	}
+
+	// tiny, compiled right away so first frame can cull
+	cull_pipeline = vk_pipelines->create_compute(
+	{
+		.shader = vkw::shader_code::load("shaders/culling.comp.spv"),
+		.dynamic_buffers = { {0, 1}, {0, 2} },
+	});
+
+	// offset into each buffer selects frame's region, both as dynamic offset and as indirect offset
+	auto alignment = vk_devices->get_physical_device().getProperties().limits.minStorageBufferOffsetAlignment;
+	draw_commands_stride = align_up(settings.instance_count * sizeof(vk::DrawIndexedIndirectCommand), alignment);
+	draw_counts_stride = align_up(sizeof(uint32_t), alignment);
+
+	// written on compute queue, read on graphics
+	auto families = vk_devices->get_queue_family().get_unique_indices();
+	auto buffer_ci = vk::BufferCreateInfo
+	{
+		.usage = vk::BufferUsageFlagBits::eStorageBuffer
+		       | vk::BufferUsageFlagBits::eIndirectBuffer
+		       | vk::BufferUsageFlagBits::eTransferSrc
+		       | vk::BufferUsageFlagBits::eTransferDst,
+		.sharingMode = families.size() > 1 ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive,
+		.queueFamilyIndexCount = static_cast<uint32_t>(families.size()),
+		.pQueueFamilyIndices = families.data()
 	};
 
-	auto render_pass_begin_info = vk::RenderPassBeginInfo
+	buffer_ci.size = draw_commands_stride * frames_in_flight;
+	std::tie(draw_commands.buffer, draw_commands.memory) = vk_allocator->create_buffer(buffer_ci, vkw::memory_usage::gpu_only);
+	buffer_ci.size = draw_counts_stride * frames_in_flight;
+	std::tie(draw_counts.buffer, draw_counts.memory) = vk_allocator->create_buffer(buffer_ci, vkw::memory_usage::gpu_only);
+
+	auto set_layout = cull_pipeline->get_set_layouts().front();
+	auto set_alloc_info = vk::DescriptorSetAllocateInfo
 	{
-		.renderPass = vk_swapchain->get_render_pass(),
-		.framebuffer = vk_swapchain->frame_buffer(image_index),
-		.renderArea = {
-			.offset = {0, 0},
-			.extent = extent
+		.descriptorPool = descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &set_layout
+	};
+	cull_descriptor_set = device.allocateDescriptorSets(set_alloc_info).front();
+
+	auto transforms_info = vk::DescriptorBufferInfo{ .buffer = instance_transforms.buffer, .offset = 0, .range = VK_WHOLE_SIZE };
+	auto commands_info = vk::DescriptorBufferInfo{ .buffer = draw_commands.buffer, .offset = 0, .range = draw_commands_stride };
+	auto counts_info = vk::DescriptorBufferInfo{ .buffer = draw_counts.buffer, .offset = 0, .range = sizeof(uint32_t) };
+	auto writes = std::array
+	{
+		vk::WriteDescriptorSet
+		{
+			.dstSet = cull_descriptor_set,
+			.dstBinding = 0,
+			.descriptorCount = 1,
+			.descriptorType = vk::DescriptorType::eStorageBuffer,
+			.pBufferInfo = &transforms_info
+		},
+		vk::WriteDescriptorSet
+		{
+			.dstSet = cull_descriptor_set,
+			.dstBinding = 1,
+			.descriptorCount = 1,
+			.descriptorType = vk::DescriptorType::eStorageBufferDynamic,
+			.pBufferInfo = &commands_info
+		},
+		vk::WriteDescriptorSet
+		{
+			.dstSet = cull_descriptor_set,
+			.dstBinding = 2,
+			.descriptorCount = 1,
+			.descriptorType = vk::DescriptorType::eStorageBufferDynamic,
+			.pBufferInfo = &counts_info
 		},
-		.clearValueCount = 1,
-		.pClearValues = &clear_color
 	};
+	device.updateDescriptorSets(writes, {});
+}
 
-	cmd_buffer.beginRenderPass(render_pass_begin_info, vk::SubpassContents::eInline);
+void renderer::dispatch_culling(uint64_t upload_value)
+{
+	// Graphics frame that last read this frame's region has completed, draw_frame waited for it.
+	// Transforms may still be uploading, so culling waits for those on GPU.
+	auto waits = std::array{ vkw::compute_queue::semaphore_wait{ vk_uploads->get_timeline().get(), upload_value } };
+	auto commands_offset = draw_commands_stride * current_frame;
+	auto counts_offset = draw_counts_stride * current_frame;
+
+	vk_compute->submit([&](vk::CommandBuffer &cmd_buffer)
 	{
-		cmd_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphics_pipeline);
+		// earlier uses are on other submissions, ordered by semaphores, so clearing the count needs no barrier
+		cmd_buffer.fillBuffer(draw_counts.buffer, counts_offset, sizeof(uint32_t), 0);
 
-		auto viewport = vk::Viewport
+		auto barriers = vkw::barrier_batch(vk_devices.get());
+		barriers.set_state(draw_counts.buffer,
 		{
-			.x = 0.0f, 
-			.y = 0.0f,
-			.width = static_cast<float>(extent.width),
-			.height = static_cast<float>(extent.height),
-			.minDepth = 0.0f,
-			.maxDepth = 1.0f
-		};
-		cmd_buffer.setViewport(0, viewport);
+			.stages = vk::PipelineStageFlagBits2::eTransfer,
+			.access = vk::AccessFlagBits2::eTransferWrite
+		});
+		barriers.use_buffer(draw_counts.buffer,
+		{
+			.stages = vk::PipelineStageFlagBits2::eComputeShader,
+			.access = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite
+		});
+		barriers.use_buffer(draw_commands.buffer,
+		{
+			.stages = vk::PipelineStageFlagBits2::eComputeShader,
+			.access = vk::AccessFlagBits2::eShaderStorageWrite
+		});
+		barriers.flush(cmd_buffer);
 
-		auto scissor = vk::Rect2D
+		auto params = cull_params
 		{
-			.offset = {0, 0},
-			.extent = extent
+			.view = make_view_transform(settings.view_scale),
+			.instance_count = settings.instance_count,
+			.index_count = mesh_index_count
 		};
-		cmd_buffer.setScissor(0, scissor);
-
-		cmd_buffer.draw(3, 1, 0, 0);
-	}
-	cmd_buffer.endRenderPass();
+		auto dynamic_offsets = std::array{ static_cast<uint32_t>(commands_offset), static_cast<uint32_t>(counts_offset) };
 
-	cmd_buffer.end();
+		cmd_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, cull_pipeline->get());
+		cmd_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cull_pipeline->get_layout(), 0, cull_descriptor_set, dynamic_offsets);
+		cmd_buffer.pushConstants(cull_pipeline->get_layout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(params), &params);
+		cmd_buffer.dispatch((settings.instance_count + cull_group_size - 1) / cull_group_size, 1, 1);
+	}, waits);
 }
 
-void renderer::create_sync_objects()
+auto renderer::read_visible_instances() -> std::vector<uint32_t>
 {
-	image_available_semaphores.resize(max_frames_in_flight);
-	render_finished_semaphores.resize(max_frames_in_flight);
-	in_flight_fences.resize(max_frames_in_flight);
+	if (not settings.gpu_culling or frame_number == 0)
+	{
+		return {};
+	}
 
-	for(auto&& [image_available_semaphore, render_finished_semaphore, in_flight_fence]
-	         : ranges::views::zip(image_available_semaphores, render_finished_semaphores, in_flight_fences))
+	auto last_frame = (current_frame + frames_in_flight - 1) % frames_in_flight;
+	auto buffer_ci = vk::BufferCreateInfo
 	{
-		auto semaphore_ci = vk::SemaphoreCreateInfo{};
-		image_available_semaphore = device.createSemaphore(semaphore_ci);
-		render_finished_semaphore = device.createSemaphore(semaphore_ci);
+		.size = draw_commands_stride + sizeof(uint32_t),
+		.usage = vk::BufferUsageFlagBits::eTransferDst,
+		.sharingMode = vk::SharingMode::eExclusive
+	};
+	auto [readback, readback_memory] = vk_allocator->create_buffer(buffer_ci, vkw::memory_usage::readback);
+
+	// same queue as culling, so submission order plus barrier puts the copy after it
+	auto done = vk_compute->submit([&](vk::CommandBuffer &cmd_buffer)
+	{
+		auto culled = vk::MemoryBarrier
+		{
+			.srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+			.dstAccessMask = vk::AccessFlagBits::eTransferRead
+		};
+		cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eTransfer,
+		                           {}, culled, {}, {});
+
+		// commands first, count right behind them
+		auto commands_copy = vk::BufferCopy{ .srcOffset = draw_commands_stride * last_frame, .dstOffset = 0, .size = draw_commands_stride };
+		auto count_copy = vk::BufferCopy{ .srcOffset = draw_counts_stride * last_frame, .dstOffset = draw_commands_stride, .size = sizeof(uint32_t) };
+		cmd_buffer.copyBuffer(draw_commands.buffer, readback, commands_copy);
+		cmd_buffer.copyBuffer(draw_counts.buffer, readback, count_copy);
 
-		auto fence_ci = vk::FenceCreateInfo
+		auto to_host = vk::MemoryBarrier
 		{
-			.flags = vk::FenceCreateFlagBits::eSignaled
+			.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+			.dstAccessMask = vk::AccessFlagBits::eHostRead
 		};
-		in_flight_fence = device.createFence(fence_ci);
+		cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+		                           {}, to_host, {}, {});
+	});
+	vk_compute->get_timeline().wait(done);
+
+	auto count = uint32_t{};
+	std::memcpy(&count, readback_memory.mapped + draw_commands_stride, sizeof(count));
+
+	auto commands = std::vector<vk::DrawIndexedIndirectCommand>(std::min(count, settings.instance_count));
+	std::memcpy(commands.data(), readback_memory.mapped, commands.size() * sizeof(vk::DrawIndexedIndirectCommand));
+	vk_allocator->destroy_buffer(readback, readback_memory);
+
+	// atomics make survivor order arbitrary
+	auto out = std::vector<uint32_t>{};
+	for (auto &command : commands)
+	{
+		out.push_back(command.firstInstance);
 	}
+	std::ranges::sort(out);
+	return out;
 }
 
-// void renderer::recreate_swap_chain(vk::Queue queue, vk::Semaphore semaphore)
-// {
-// 	device.waitIdle();
+void renderer::write_startup_trace()
+{
+	if (not is_tracing())
+	{
+		return;
+	}
 
-// 	reset_semaphore(queue, semaphore);
+	try
+	{
+		end_trace(settings.startup_trace_path);
+		std::cerr << std::format("Startup trace written to {}\n", settings.startup_trace_path.string());
+	}
+	catch (std::exception &err)
+	{
+		std::cerr << std::format("Failed to write startup trace: {}\n", err.what());
+	}
+}
 
-// 	destroy_swap_chain();
+void renderer::recreate_swap_chain()
+{
+	swap_chain_dirty = false;
 
-// 	//create_swap_chain();
-// 	create_image_views();
-// 	create_frame_buffers();
-// }
+	// old images go away with their swap chain, begin_target seeds the new ones' state
+	for (auto index : ranges::views::iota(0u, vk_target->image_count()))
+	{
+		target_barriers->forget(vk_target->image(index));
+	}
 
-void renderer::reset_semaphore(vk::Queue queue, vk::Semaphore semaphore)
-{
-	auto psw = vk::PipelineStageFlags(vk::PipelineStageFlagBits::eBottomOfPipe);
-	auto submit_ci = vk::SubmitInfo
+	// Submitted frames may still use the old swap chain, 
+	// it is released once they complete instead of waiting for device to idle
+	swap_chain_minimized = not vk_swapchain->recreate(frame_number);
+	if (not swap_chain_minimized)
 	{
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &semaphore,
-		.pWaitDstStageMask = &psw
-	};
+		// cached commands reference old frame buffers or image views, and extent
+		invalidate_commands();
+	}
+}
 
-	queue.submit({submit_ci}, nullptr);
+auto renderer::completed_frame() const -> uint64_t
+{
+	return frame_timeline->completed_value();
 }
@@ -1,51 +1,218 @@
 #pragma once
 
+#include "render_settings.hpp"
+#include "vk/pipeline.hpp"
+#include "vk/memory_allocator.hpp"
+
 namespace vulkan_eg
 {
 	namespace vkw
 	{
 		class instance;
 		class devices;
+		struct device_choice;
 		class swap_chain;
+		class offscreen_target;
+		class render_target;
+		class gpu_timer;
+		class timeline;
+		class pipeline_cache;
+		class upload_service;
+		class uniform_ring;
+		class compute_queue;
+		class bindless_heap;
+		class barrier_batch;
 	}
 
+	class thread_pool;
+	class shader_watcher;
+
 	class renderer
 	{
 	public:
-		renderer(HWND windowHandle);
+		// CPU time spent in each stage of the last draw_frame call, in milliseconds
+		struct frame_timings
+		{
+			double wait_frame{};
+			double acquire{};
+			double record{};
+			double submit{};
+			double present{};
+		};
+
+		// One-off costs paid while constructing renderer
+		struct startup_timings
+		{
+			double pipeline_creation{};   // milliseconds, compiled on a worker thread, valid once pipelines_ready
+			bool pipeline_cache_warm{};   // loaded valid pipeline cache from disk
+			bool pipelines_ready{};       // draws are skipped until pipelines finish compiling
+		};
+
+		// GPU time of the most recently completed frame, in milliseconds
+		struct gpu_timings
+		{
+			double render_pass{};
+			std::vector<std::tuple<std::string, double>> draw_scopes{};
+		};
+
+	public:
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+		renderer(HWND windowHandle, const render_settings &settings = {});
+#endif
+		// Headless, renders into offscreen images instead of a swap chain
+		explicit renderer(vk::Extent2D extent, const render_settings &settings = {});
 		~renderer();
 
 		void draw_frame();
+		// Call when window size changes, swap chain is recreated at start of next frame
+		void resize();
+		// Call when scene or pipelines change, cached command buffers get re-recorded before next use
+		void invalidate_commands();
+		// Blocks until pipelines compiling in background are ready
+		void wait_for_pipelines();
+
+		[[nodiscard]] auto get_frame_timings() const -> const frame_timings &;
+		[[nodiscard]] auto get_gpu_timings() const -> const gpu_timings &;
+		[[nodiscard]] auto get_startup_timings() const -> const startup_timings &;
+		[[nodiscard]] auto get_memory_stats() const -> vkw::memory_stats;
+		[[nodiscard]] auto get_device_name() const -> std::string;
+		[[nodiscard]] auto get_device_choice() const -> const vkw::device_choice &;
+		// settings' path, unless device lacked dynamic rendering
+		[[nodiscard]] auto get_render_path() const -> render_path;
+		// Instances GPU culling kept in last submitted frame, sorted. Waits for GPU, meant for validation.
+		[[nodiscard]] auto read_visible_instances() -> std::vector<uint32_t>;
 
 	private:
+		void create_renderer_objects();
 		void create_graphics_pipeline();
 		void create_command_pool();
 		void create_command_buffer();
+		void create_parallel_recording();
 		void create_sync_objects();
+		void create_descriptor_pool();
+		void create_scene();
+		void create_culling();
+		void dispatch_culling(uint64_t upload_value);
+		// writes settings.startup_trace_path, if trace is still being recorded
+		void write_startup_trace();
 
 		void record_command_buffer(vk::CommandBuffer &cmd_buffer, uint32_t image_index);
+		// render pass or dynamic rendering, by settings.rendering
+		void begin_target(vk::CommandBuffer &cmd_buffer, uint32_t image_index, vk::SubpassContents contents);
+		void end_target(vk::CommandBuffer &cmd_buffer, uint32_t image_index);
+		void record_parallel(vk::CommandBuffer &cmd_buffer, uint32_t image_index);
+		void record_draws(vk::CommandBuffer &cmd_buffer, uint32_t first_draw, uint32_t draw_count);
+		[[nodiscard]] auto get_cached_command_buffer(uint32_t image_index) -> vk::CommandBuffer;
+		void collect_gpu_timings();
+		void update_pipelines();
+		void update_draw_descriptors();
+		void write_draw_constants();
+		void reload_shaders();
+
+		void recreate_swap_chain();
+		[[nodiscard]] auto completed_frame() const -> uint64_t;
+
+	private:
+		struct cached_command_buffer
+		{
+			vk::CommandBuffer buffer;
+			uint64_t generation{0};
+			uint64_t last_used_frame{0};
+		};
+
+		// replacement for a pipeline, swapped in at a frame boundary once compiled
+		struct pending_pipeline
+		{
+			vkw::pipeline_descriptor desc;
+			vkw::pipeline_handle handle;
+		};
+
+		struct secondary_commands
+		{
+			vk::CommandPool pool;
+			vk::CommandBuffer buffer;
+		};
 
-		void reset_semaphore(vk::Queue queue, vk::Semaphore semaphore);
+		struct gpu_buffer
+		{
+			vk::Buffer buffer;
+			vkw::allocation memory;
+		};
+
+		// device local buffer, filled through the upload service before first frame that uses it
+		[[nodiscard]] auto create_static_buffer(std::span<const std::byte> data, vk::BufferUsageFlags usage) -> gpu_buffer;
+		void destroy_buffer(gpu_buffer &buffer);
 
 	private:
 		std::unique_ptr<vkw::instance> vk_instance;
 		std::unique_ptr<vkw::devices> vk_devices;
+		std::unique_ptr<vkw::memory_allocator> vk_allocator;
+		std::unique_ptr<vkw::upload_service> vk_uploads;
+		std::unique_ptr<vkw::uniform_ring> vk_uniforms;
+		std::unique_ptr<vkw::compute_queue> vk_compute;
+		std::unique_ptr<vkw::bindless_heap> vk_bindless;
+		std::unique_ptr<vkw::barrier_batch> target_barriers;  // target image transitions with dynamic rendering, frame thread only
 		std::unique_ptr<vkw::swap_chain> vk_swapchain;
+		std::unique_ptr<vkw::offscreen_target> vk_offscreen;
+		std::unique_ptr<vkw::pipeline_cache> vk_pipeline_cache;
+		std::unique_ptr<vkw::pipeline_factory> vk_pipelines;
+		vkw::render_target *vk_target{nullptr};
+		std::unique_ptr<vkw::gpu_timer> vk_gpu_timer;
 
 		vk::Instance instance;
 		vk::SurfaceKHR surface;
 		vk::PhysicalDevice physical_device;
 		vk::Device device;
 
-		vk::PipelineLayout pipeline_layout;
-		vk::Pipeline graphics_pipeline;
+		std::unique_ptr<thread_pool> compile_threads;
+		vkw::pipeline_descriptor graphics_pipeline_desc;
+		vkw::pipeline_handle graphics_pipeline;
+
+		std::unique_ptr<shader_watcher> shader_watch;
+		std::optional<pending_pipeline> reloaded_pipeline;
+		std::deque<std::tuple<uint64_t, vkw::pipeline_handle>> retired_pipelines; // last frame using it
+
+		vk::DescriptorPool descriptor_pool;
+		vk::DescriptorSetLayout draw_set_layout;
+		vk::DescriptorSet draw_descriptor_set;  // uniform ring, per draw dynamic offsets
+		std::deque<std::tuple<uint64_t, vk::DescriptorSet>> retired_descriptor_sets; // last frame using it
+		std::vector<uint32_t> draw_offsets;     // this frame's dynamic offset of each draw's constants
+		uint32_t uniforms_handle{};             // uniform ring in bindless heap, only with settings.bindless
+
+		// instanced scene, only with settings.instance_count > 0
+		gpu_buffer mesh_vertices;
+		gpu_buffer mesh_indices;
+		gpu_buffer instance_transforms;         // SoA, one tightly packed buffer per attribute
+		gpu_buffer instance_colors;
+		uint32_t mesh_index_count{};
+
+		// GPU culling, only with settings.gpu_culling
+		std::unique_ptr<vkw::compute_pipeline> cull_pipeline;
+		vk::DescriptorSet cull_descriptor_set;
+		gpu_buffer draw_commands;               // region per frame in flight, written by culling, read by drawIndexedIndirectCount
+		gpu_buffer draw_counts;
+		vk::DeviceSize draw_commands_stride{};  // bytes per frame region
+		vk::DeviceSize draw_counts_stride{};
 		vk::CommandPool command_pool;
 		std::vector<vk::CommandBuffer> command_buffers;
+		std::vector<cached_command_buffer> cached_commands; // [target image * frames in flight + frame]
+		uint64_t commands_generation{1};
+
+		std::unique_ptr<thread_pool> recording_threads;
+		std::vector<std::vector<secondary_commands>> parallel_pools; // [frame in flight][worker]
 
-		std::vector<vk::Semaphore> image_available_semaphores;
-		std::vector<vk::Semaphore> render_finished_semaphores;
-		std::vector<vk::Fence> in_flight_fences;
+		std::unique_ptr<vkw::timeline> frame_timeline;
+		std::vector<vk::Semaphore> image_available_semaphores;  // per frame in flight
 
+		render_settings settings;
+		uint32_t frames_in_flight{};
 		uint32_t current_frame{0};
+		uint64_t frame_number{0};
+		bool swap_chain_dirty{false};
+		bool swap_chain_minimized{false};
+		bool drew_frame{false};         // a frame with draws has been submitted
+		frame_timings timings{};
+		gpu_timings gpu_frame_timings{};
+		startup_timings startup{};
 	};
 }
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "scene.hpp"
+
+using namespace vulkan_eg;
+
+namespace
+{
+	// bounding circle radius of make_quad, per unit of scale
+	constexpr auto quad_radius = 0.70710678f;
+
+	auto pack_color(glm::vec3 color) -> uint32_t
+	{
+		auto to_byte = [](float c) -> uint32_t
+		{
+			return static_cast<uint32_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+		};
+
+		return to_byte(color.r)
+		     | (to_byte(color.g) << 8)
+		     | (to_byte(color.b) << 16)
+		     | (0xffu << 24);
+	}
+}
+
+auto instance_soa::size() const -> uint32_t
+{
+	return static_cast<uint32_t>(transforms.size());
+}
+
+auto vulkan_eg::make_quad() -> mesh_data
+{
+	return mesh_data
+	{
+		.vertices = {
+			{ -0.5f, -0.5f },
+			{  0.5f, -0.5f },
+			{  0.5f,  0.5f },
+			{ -0.5f,  0.5f },
+		},
+		.indices = { 0, 1, 2, 2, 3, 0 },
+	};
+}
+
+auto vulkan_eg::make_grid_instances(uint32_t count) -> instance_soa
+{
+	auto out = instance_soa{};
+	out.transforms.reserve(count);
+	out.colors.reserve(count);
+
+	auto columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	auto cell = 2.0f / static_cast<float>(std::max(columns, 1u));
+
+	for (auto i = 0u; i < count; ++i)
+	{
+		auto column = i % columns;
+		auto row = i / columns;
+		auto u = (static_cast<float>(column) + 0.5f) / static_cast<float>(columns);
+		auto v = (static_cast<float>(row) + 0.5f) / static_cast<float>(columns);
+
+		out.transforms.emplace_back(
+			-1.0f + cell * (static_cast<float>(column) + 0.5f),
+			-1.0f + cell * (static_cast<float>(row) + 0.5f),
+			cell * 0.8f,
+			static_cast<float>(i % 16) * (std::numbers::pi_v<float> / 32.0f));
+
+		out.colors.push_back(pack_color({ u, v, 1.0f - u }));
+	}
+
+	return out;
+}
+
+auto vulkan_eg::make_view_transform(float view_scale) -> glm::mat4
+{
+	return glm::mat4
+	{
+		{ view_scale, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, view_scale, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, 0.0f, 1.0f },
+	};
+}
+
+auto vulkan_eg::cull_instances(const instance_soa &instances, const glm::mat4 &view, float margin) -> std::vector<uint32_t>
+{
+	auto out = std::vector<uint32_t>{};
+
+	// same test as culling.comp
+	auto view_scale = glm::length(glm::vec2(view[0]));
+	for (auto i = 0u; i < instances.size(); ++i)
+	{
+		auto &transform = instances.transforms[i];
+		auto center = view * glm::vec4(transform.x, transform.y, 0.0f, 1.0f);
+		auto radius = transform.z * quad_radius * view_scale + margin;
+
+		auto outside = std::abs(center.x) - radius > center.w
+		            or std::abs(center.y) - radius > center.w;
+		if (not outside)
+		{
+			out.push_back(i);
+		}
+	}
+
+	return out;
+}
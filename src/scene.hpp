@@ -0,0 +1,35 @@
+#pragma once
+
+namespace vulkan_eg
+{
+	// Per instance data as structure of arrays.
+	// Each array is uploaded to its own tightly packed vertex buffer, bound at instance rate.
+	struct instance_soa
+	{
+		std::vector<glm::vec4> transforms;  // xy translation, z uniform scale, w rotation in radians
+		std::vector<uint32_t> colors;       // RGBA8 unorm, red in lowest byte
+
+		[[nodiscard]] auto size() const -> uint32_t;
+	};
+
+	// Indexed mesh, 2D positions
+	struct mesh_data
+	{
+		std::vector<glm::vec2> vertices;
+		std::vector<uint16_t> indices;
+	};
+
+	// Unit quad centred on origin, clockwise like the built in triangle
+	[[nodiscard]] auto make_quad() -> mesh_data;
+
+	// count instances on a square grid covering clip space, rotation and color vary per instance
+	[[nodiscard]] auto make_grid_instances(uint32_t count) -> instance_soa;
+
+	// 2D zoom around the origin
+	[[nodiscard]] auto make_view_transform(float view_scale) -> glm::mat4;
+
+	// CPU reference of culling.comp: indices of instances whose bounding circle overlaps clip space
+	// after view, in instance order. margin grows (or shrinks, if negative) every radius, in clip space units,
+	// to bracket GPU results that differ in float rounding right at the boundary.
+	[[nodiscard]] auto cull_instances(const instance_soa &instances, const glm::mat4 &view, float margin = 0.0f) -> std::vector<uint32_t>;
+}
@@ -0,0 +1,239 @@
+#include "shader_watcher.hpp"
+
+#if __has_include(<shader_sources.hpp>)
+#include <shader_sources.hpp>
+#define HAS_SHADER_SOURCES
+#endif
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace vulkan_eg;
+using namespace std::chrono_literals;
+
+namespace
+{
+	// how often stop is checked while idle
+	constexpr auto poll_interval = 250ms;
+	// editors often write a file in several steps, let them finish before compiling
+	constexpr auto settle_time = 50ms;
+
+	auto quoted(const std::filesystem::path &path) -> std::string
+	{
+		return std::format("\"{}\"", path.string());
+	}
+}
+
+shader_watcher::shader_watcher(std::filesystem::path glslc, std::vector<shader_source> shaders)
+	: glslc{ std::move(glslc) }, shaders{ std::move(shaders) }
+{
+#ifdef __linux__
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0)
+	{
+		throw std::runtime_error("Failed to initialize inotify");
+	}
+
+	// Watch directories rather than files, editors often save by replacing the file
+	for (auto &shader : this->shaders)
+	{
+		auto dir = shader.source.parent_path();
+		if (std::ranges::any_of(watched_dirs, [&](auto &&watched) { return std::get<1>(watched) == dir; }))
+		{
+			continue;
+		}
+
+		auto wd = inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (wd < 0)
+		{
+			close(inotify_fd);
+			throw std::runtime_error(std::format("Failed to watch {}", dir.string()));
+		}
+		watched_dirs.emplace_back(wd, dir);
+	}
+#else
+	for (auto &shader : this->shaders)
+	{
+		auto ec = std::error_code{};
+		last_write_times.push_back(std::filesystem::last_write_time(shader.source, ec));
+	}
+#endif
+
+	watcher = std::jthread([this](std::stop_token stop)
+	{
+		watch_loop(stop);
+	});
+}
+
+shader_watcher::~shader_watcher()
+{
+	watcher.request_stop();
+	if (watcher.joinable())
+	{
+		watcher.join();
+	}
+
+#ifdef __linux__
+	close(inotify_fd);
+#endif
+}
+
+auto shader_watcher::from_build() -> std::unique_ptr<shader_watcher>
+{
+#ifdef HAS_SHADER_SOURCES
+	auto sources = std::vector<shader_source>{};
+	for (auto &&[name, source, spv] : shader_sources::all)
+	{
+		sources.push_back({ std::string(name), source, spv });
+	}
+	return std::make_unique<shader_watcher>(shader_sources::glslc, std::move(sources));
+#else
+	return nullptr;
+#endif
+}
+
+auto shader_watcher::poll() -> std::vector<shader_source>
+{
+	auto lock = std::scoped_lock(rebuilt_mutex);
+	return std::exchange(rebuilt, {});
+}
+
+void shader_watcher::watch_loop(std::stop_token stop)
+{
+	while (not stop.stop_requested())
+	{
+		auto changed = wait_for_changes(stop);
+		for (auto index : changed)
+		{
+			auto &shader = shaders.at(index);
+			if (not compile(shader))
+			{
+				continue;
+			}
+
+			auto lock = std::scoped_lock(rebuilt_mutex);
+			std::erase_if(rebuilt, [&](auto &&r) { return r.name == shader.name; });
+			rebuilt.push_back(shader);
+		}
+	}
+}
+
+#ifdef __linux__
+auto shader_watcher::wait_for_changes(std::stop_token stop) -> std::vector<size_t>
+{
+	auto changed = std::vector<size_t>{};
+	auto buffer = std::array<char, 4096>{};
+
+	auto read_events = [&]()
+	{
+		while (true)
+		{
+			auto length = read(inotify_fd, buffer.data(), buffer.size());
+			if (length <= 0)
+			{
+				return;
+			}
+
+			for (auto offset = ssize_t{ 0 }; offset < length;)
+			{
+				auto event = reinterpret_cast<const inotify_event *>(buffer.data() + offset);
+				offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+				if (event->len == 0)
+				{
+					continue;
+				}
+
+				auto watched = std::ranges::find_if(watched_dirs, [&](auto &&w) { return std::get<0>(w) == event->wd; });
+				if (watched == watched_dirs.end())
+				{
+					continue;
+				}
+
+				auto path = std::get<1>(*watched) / event->name;
+				for (auto index = size_t{ 0 }; index < shaders.size(); ++index)
+				{
+					if (shaders.at(index).source == path and std::ranges::find(changed, index) == changed.end())
+					{
+						changed.push_back(index);
+					}
+				}
+			}
+		}
+	};
+
+	auto fds = pollfd{ .fd = inotify_fd, .events = POLLIN };
+	while (changed.empty() and not stop.stop_requested())
+	{
+		if (::poll(&fds, 1, static_cast<int>(poll_interval.count())) > 0)
+		{
+			read_events();
+		}
+	}
+
+	if (not changed.empty())
+	{
+		std::this_thread::sleep_for(settle_time);
+		read_events();
+	}
+
+	return changed;
+}
+#else
+auto shader_watcher::wait_for_changes(std::stop_token stop) -> std::vector<size_t>
+{
+	auto changed = std::vector<size_t>{};
+	while (changed.empty() and not stop.stop_requested())
+	{
+		std::this_thread::sleep_for(poll_interval);
+		for (auto index = size_t{ 0 }; index < shaders.size(); ++index)
+		{
+			auto ec = std::error_code{};
+			auto write_time = std::filesystem::last_write_time(shaders.at(index).source, ec);
+			if (not ec and write_time != last_write_times.at(index))
+			{
+				last_write_times.at(index) = write_time;
+				changed.push_back(index);
+			}
+		}
+	}
+
+	if (not changed.empty())
+	{
+		std::this_thread::sleep_for(settle_time);
+	}
+
+	return changed;
+}
+#endif
+
+auto shader_watcher::compile(const shader_source &shader) const -> bool
+{
+	// Write next to output then rename, so a half written file is never mapped
+	auto temp = shader.spv;
+	temp += ".tmp";
+
+	auto command = std::format("{} {} -o {}", quoted(glslc), quoted(shader.source), quoted(temp));
+#ifdef _WIN32
+	// cmd strips outer quotes of the whole command line
+	command = std::format("\"{}\"", command);
+#endif
+
+	if (std::system(command.c_str()) != 0)
+	{
+		std::cerr << std::format("Shader compile failed: {}\n", shader.source.string());
+		return false;
+	}
+
+	auto ec = std::error_code{};
+	std::filesystem::rename(temp, shader.spv, ec);
+	if (ec)
+	{
+		std::cerr << std::format("Failed to replace {}: {}\n", shader.spv.string(), ec.message());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+namespace vulkan_eg
+{
+	// Watches GLSL sources and recompiles them to SPIR-V on a background thread.
+	// Uses inotify on Linux, elsewhere file timestamps are polled.
+	class shader_watcher
+	{
+	public:
+		struct shader_source
+		{
+			std::string name;             // as loaded by renderer, e.g. "shaders/simple_shader.vert.spv"
+			std::filesystem::path source; // GLSL file
+			std::filesystem::path spv;    // compiled output
+		};
+
+		shader_watcher(std::filesystem::path glslc, std::vector<shader_source> shaders);
+		~shader_watcher();
+
+		shader_watcher() = delete;
+		shader_watcher(const shader_watcher &) = delete;
+		auto operator=(const shader_watcher &) -> shader_watcher & = delete;
+
+		// Shaders and glslc recorded by target_shader_sources, nullptr if build has none
+		[[nodiscard]] static auto from_build() -> std::unique_ptr<shader_watcher>;
+
+		// Shaders rebuilt since last call, their SPIR-V file is complete
+		[[nodiscard]] auto poll() -> std::vector<shader_source>;
+
+	private:
+		void watch_loop(std::stop_token stop);
+		// indices of changed shaders, empty if stop was requested
+		[[nodiscard]] auto wait_for_changes(std::stop_token stop) -> std::vector<size_t>;
+		[[nodiscard]] auto compile(const shader_source &shader) const -> bool;
+
+	private:
+		std::filesystem::path glslc;
+		std::vector<shader_source> shaders;
+
+		std::mutex rebuilt_mutex;
+		std::vector<shader_source> rebuilt;
+
+#ifdef __linux__
+		int inotify_fd{-1};
+		std::vector<std::tuple<int, std::filesystem::path>> watched_dirs; // inotify watch, directory
+#else
+		std::vector<std::filesystem::file_time_type> last_write_times;
+#endif
+		std::jthread watcher;
+	};
+}
@@ -0,0 +1,24 @@
+#version 450
+
+layout(location = 0) in vec2 position;            // per vertex
+layout(location = 1) in vec4 instance_transform;  // per instance, xy translation, z scale, w rotation
+layout(location = 2) in vec4 instance_color;      // per instance, RGBA8 unorm in its own buffer
+
+// per draw, bound with a dynamic offset into the frame's uniform ring
+layout(set = 0, binding = 0) uniform draw_constants
+{
+	mat4 transform;
+	vec4 tint;
+} draw;
+
+layout(location = 0) out vec3 fragColor;
+
+void main()
+{
+	float s = sin(instance_transform.w);
+	float c = cos(instance_transform.w);
+	vec2 local = mat2(c, s, -s, c) * position * instance_transform.z;
+
+	gl_Position = draw.transform * vec4(local + instance_transform.xy, 0.0, 1.0);
+	fragColor = instance_color.rgb * draw.tint.rgb;
+}
@@ -0,0 +1,38 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 position;            // per vertex
+layout(location = 1) in vec4 instance_transform;  // per instance, xy translation, z scale, w rotation
+layout(location = 2) in vec4 instance_color;      // per instance, RGBA8 unorm in its own buffer
+
+// bindless heap's storage buffers, see vkw::bindless_heap
+layout(set = 0, binding = 1) readonly buffer heap_buffer
+{
+	vec4 data[];
+} buffers[];
+
+// per draw, where its draw_constants (mat4 transform, vec4 tint) are in the frame's uniform ring
+layout(push_constant) uniform draw_handles
+{
+	uint constants_buffer;
+	uint constants_index;   // in vec4s
+} handles;
+
+layout(location = 0) out vec3 fragColor;
+
+void main()
+{
+	uint i = handles.constants_index;
+	mat4 transform = mat4(buffers[handles.constants_buffer].data[i],
+	                      buffers[handles.constants_buffer].data[i + 1],
+	                      buffers[handles.constants_buffer].data[i + 2],
+	                      buffers[handles.constants_buffer].data[i + 3]);
+	vec4 tint = buffers[handles.constants_buffer].data[i + 4];
+
+	float s = sin(instance_transform.w);
+	float c = cos(instance_transform.w);
+	vec2 local = mat2(c, s, -s, c) * position * instance_transform.z;
+
+	gl_Position = transform * vec4(local + instance_transform.xy, 0.0, 1.0);
+	fragColor = instance_color.rgb * tint.rgb;
+}
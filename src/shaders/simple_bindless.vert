@@ -0,0 +1,42 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+vec2 positions[3] = vec2[] (
+	vec2(0.0, -0.5),
+	vec2(0.5, 0.5),
+	vec2(-0.5, 0.5)
+);
+
+vec3 colors[3] = vec3[] (
+	vec3(1.0, 0.0, 0.0),
+	vec3(0.0, 1.0, 0.0),
+	vec3(0.0, 0.0, 1.0)
+);
+
+// bindless heap's storage buffers, see vkw::bindless_heap
+layout(set = 0, binding = 1) readonly buffer heap_buffer
+{
+	vec4 data[];
+} buffers[];
+
+// per draw, where its draw_constants (mat4 transform, vec4 tint) are in the frame's uniform ring
+layout(push_constant) uniform draw_handles
+{
+	uint constants_buffer;
+	uint constants_index;   // in vec4s
+} handles;
+
+layout(location = 0) out vec3 fragColor;
+
+void main()
+{
+	uint i = handles.constants_index;
+	mat4 transform = mat4(buffers[handles.constants_buffer].data[i],
+	                      buffers[handles.constants_buffer].data[i + 1],
+	                      buffers[handles.constants_buffer].data[i + 2],
+	                      buffers[handles.constants_buffer].data[i + 3]);
+	vec4 tint = buffers[handles.constants_buffer].data[i + 4];
+
+	gl_Position = transform * vec4(positions[gl_VertexIndex], 0.0, 1.0);
+	fragColor = colors[gl_VertexIndex] * tint.rgb;
+}
@@ -12,10 +12,17 @@ vec3 colors[3] = vec3[] (
 	vec3(0.0, 0.0, 1.0)
 );
 
+// per draw, bound with a dynamic offset into the frame's uniform ring
+layout(set = 0, binding = 0) uniform draw_constants
+{
+	mat4 transform;
+	vec4 tint;
+} draw;
+
 layout(location = 0) out vec3 fragColor;
 
 void main()
 {
-	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-	fragColor = colors[gl_VertexIndex];
+	gl_Position = draw.transform * vec4(positions[gl_VertexIndex], 0.0, 1.0);
+	fragColor = colors[gl_VertexIndex] * draw.tint.rgb;
 }
@@ -0,0 +1,108 @@
+#include "startup_trace.hpp"
+
+using namespace vulkan_eg;
+
+namespace
+{
+	using timer = std::chrono::steady_clock;
+	using us = std::chrono::duration<double, std::micro>;
+
+	struct trace_event
+	{
+		const char *name;
+		std::thread::id thread;
+		timer::time_point start;
+		timer::time_point end;
+	};
+
+	std::atomic<bool> recording{false};
+	std::mutex events_mutex;
+	timer::time_point trace_start;
+	std::vector<trace_event> events;
+}
+
+trace_scope::trace_scope(const char *scope_name)
+	: name{ scope_name }
+{
+	if (recording.load(std::memory_order_acquire))
+	{
+		start = timer::now();
+	}
+}
+
+trace_scope::~trace_scope()
+{
+	if (not start or not recording.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	auto end = timer::now();
+	auto lock = std::scoped_lock(events_mutex);
+	events.push_back(
+	{
+		.name = name,
+		.thread = std::this_thread::get_id(),
+		.start = *start,
+		.end = end
+	});
+}
+
+void vulkan_eg::begin_trace()
+{
+	auto lock = std::scoped_lock(events_mutex);
+	events.clear();
+	trace_start = timer::now();
+	recording.store(true, std::memory_order_release);
+}
+
+void vulkan_eg::end_trace(const std::filesystem::path &file_path)
+{
+	auto recorded = std::vector<trace_event>{};
+	{
+		auto lock = std::scoped_lock(events_mutex);
+		if (not recording.exchange(false))
+		{
+			return;
+		}
+		recorded = std::exchange(events, {});
+	}
+
+	auto file = std::ofstream(file_path, std::ios::trunc);
+	if (not file.is_open())
+	{
+		throw std::runtime_error(std::format("Unable to open {}", file_path.string()));
+	}
+
+	// tids are numbered in order of first appearance, instead of the platform's opaque thread ids
+	auto threads = std::vector<std::thread::id>{};
+	auto separator = "";
+	file << "{\"traceEvents\": [\n";
+	for (auto &event : recorded)
+	{
+		auto thread_iter = std::ranges::find(threads, event.thread);
+		if (thread_iter == threads.end())
+		{
+			thread_iter = threads.insert(threads.end(), event.thread);
+		}
+
+		file << std::format("{}\t{{\"name\": \"{}\", \"cat\": \"startup\", \"ph\": \"X\", \"pid\": 1, \"tid\": {}, \"ts\": {:.3f}, \"dur\": {:.3f}}}",
+		                    separator,
+		                    event.name,
+		                    std::distance(threads.begin(), thread_iter),
+		                    us(event.start - trace_start).count(),
+		                    us(event.end - event.start).count());
+		separator = ",\n";
+	}
+	file << "\n], \"displayTimeUnit\": \"ms\"}\n";
+
+	if (not file)
+	{
+		throw std::runtime_error(std::format("Unable to write {}", file_path.string()));
+	}
+}
+
+auto vulkan_eg::is_tracing() -> bool
+{
+	return recording.load(std::memory_order_acquire);
+}
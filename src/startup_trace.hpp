@@ -0,0 +1,31 @@
+#pragma once
+
+namespace vulkan_eg
+{
+	// Records how long a scope took, as a complete event in Chrome's trace event format.
+	// Written file opens in chrome://tracing or ui.perfetto.dev, one track per thread.
+	//
+	// Scopes only record between begin_trace and end_trace, outside of that they cost one atomic load.
+	class trace_scope
+	{
+	public:
+		// name is kept by pointer, so it has to outlive the trace, e.g. a string literal
+		explicit trace_scope(const char *scope_name);
+		~trace_scope();
+
+		trace_scope() = delete;
+		trace_scope(const trace_scope &) = delete;
+		auto operator=(const trace_scope &) -> trace_scope & = delete;
+
+	private:
+		const char *name;
+		std::optional<std::chrono::steady_clock::time_point> start;
+	};
+
+	// Starts recording scopes on all threads, dropping anything recorded before
+	void begin_trace();
+	// Stops recording and writes scopes that ended since begin_trace. Does nothing when not recording.
+	// Throws std::runtime_error when file can't be written.
+	void end_trace(const std::filesystem::path &file);
+	[[nodiscard]] auto is_tracing() -> bool;
+}
@@ -0,0 +1,54 @@
+#include "thread_pool.hpp"
+
+using namespace vulkan_eg;
+
+thread_pool::thread_pool(uint32_t thread_count)
+{
+	workers.reserve(thread_count);
+	for (auto i = 0u; i < thread_count; ++i)
+	{
+		workers.emplace_back([this](std::stop_token stop)
+		{
+			worker_loop(stop);
+		});
+	}
+}
+
+thread_pool::~thread_pool()
+{
+	for (auto &worker : workers)
+	{
+		worker.request_stop();
+	}
+	tasks_cv.notify_all();
+
+	// jthread joins on destruction
+	workers.clear();
+}
+
+auto thread_pool::size() const -> uint32_t
+{
+	return static_cast<uint32_t>(workers.size());
+}
+
+void thread_pool::worker_loop(std::stop_token stop)
+{
+	while (true)
+	{
+		auto task = std::function<void()>{};
+		{
+			auto lock = std::unique_lock(tasks_mutex);
+			tasks_cv.wait(lock, stop, [&]() { return not tasks.empty(); });
+			if (tasks.empty())
+			{
+				// stop was requested and nothing is left to run
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+namespace vulkan_eg
+{
+	// Fixed set of worker threads running queued tasks in submission order
+	class thread_pool
+	{
+	public:
+		explicit thread_pool(uint32_t thread_count);
+		~thread_pool();
+
+		thread_pool() = delete;
+		thread_pool(const thread_pool &) = delete;
+		auto operator=(const thread_pool &) -> thread_pool & = delete;
+
+		template <typename F>
+		auto submit(F &&task) -> std::future<std::invoke_result_t<F>>
+		{
+			using result_t = std::invoke_result_t<F>;
+
+			// std::function must be copyable, packaged_task isn't
+			auto packaged = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(task));
+			auto future = packaged->get_future();
+			{
+				auto lock = std::scoped_lock(tasks_mutex);
+				tasks.emplace_back([packaged]() { (*packaged)(); });
+			}
+			tasks_cv.notify_one();
+
+			return future;
+		}
+
+		[[nodiscard]] auto size() const -> uint32_t;
+
+	private:
+		void worker_loop(std::stop_token stop);
+
+	private:
+		std::mutex tasks_mutex;
+		std::condition_variable_any tasks_cv;
+		std::deque<std::function<void()>> tasks;
+		std::vector<std::jthread> workers;
+	};
+}
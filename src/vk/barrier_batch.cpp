@@ -0,0 +1,279 @@
+#include "barrier_batch.hpp"
+
+#include "devices.hpp"
+
+using namespace vulkan_eg::vkw;
+
+namespace
+{
+	constexpr auto write_access = vk::AccessFlagBits2::eShaderWrite
+	                            | vk::AccessFlagBits2::eShaderStorageWrite
+	                            | vk::AccessFlagBits2::eColorAttachmentWrite
+	                            | vk::AccessFlagBits2::eDepthStencilAttachmentWrite
+	                            | vk::AccessFlagBits2::eTransferWrite
+	                            | vk::AccessFlagBits2::eHostWrite
+	                            | vk::AccessFlagBits2::eMemoryWrite;
+
+	// Low 32 bits of synchronization2 flags are the original ones.
+	// Finer grained bits added with synchronization2 map to the original bit covering them.
+	constexpr auto legacy_stages = std::array
+	{
+		std::tuple{ vk::PipelineStageFlags2{ vk::PipelineStageFlagBits2::eCopy }, vk::PipelineStageFlags{ vk::PipelineStageFlagBits::eTransfer } },
+		std::tuple{ vk::PipelineStageFlags2{ vk::PipelineStageFlagBits2::eBlit }, vk::PipelineStageFlags{ vk::PipelineStageFlagBits::eTransfer } },
+		std::tuple{ vk::PipelineStageFlags2{ vk::PipelineStageFlagBits2::eClear }, vk::PipelineStageFlags{ vk::PipelineStageFlagBits::eTransfer } },
+		std::tuple{ vk::PipelineStageFlags2{ vk::PipelineStageFlagBits2::eResolve }, vk::PipelineStageFlags{ vk::PipelineStageFlagBits::eTransfer } },
+		std::tuple{ vk::PipelineStageFlags2{ vk::PipelineStageFlagBits2::eIndexInput }, vk::PipelineStageFlags{ vk::PipelineStageFlagBits::eVertexInput } },
+		std::tuple{ vk::PipelineStageFlags2{ vk::PipelineStageFlagBits2::eVertexAttributeInput }, vk::PipelineStageFlags{ vk::PipelineStageFlagBits::eVertexInput } },
+		// tessellation and geometry stages need features devices doesn't enable, vertex is the only one left
+		std::tuple{ vk::PipelineStageFlags2{ vk::PipelineStageFlagBits2::ePreRasterizationShaders }, vk::PipelineStageFlags{ vk::PipelineStageFlagBits::eVertexShader } },
+	};
+
+	constexpr auto legacy_access = std::array
+	{
+		std::tuple{ vk::AccessFlags2{ vk::AccessFlagBits2::eShaderSampledRead }, vk::AccessFlags{ vk::AccessFlagBits::eShaderRead } },
+		std::tuple{ vk::AccessFlags2{ vk::AccessFlagBits2::eShaderStorageRead }, vk::AccessFlags{ vk::AccessFlagBits::eShaderRead } },
+		std::tuple{ vk::AccessFlags2{ vk::AccessFlagBits2::eShaderStorageWrite }, vk::AccessFlags{ vk::AccessFlagBits::eShaderWrite } },
+	};
+
+	auto to_legacy(vk::PipelineStageFlags2 stages, vk::PipelineStageFlagBits if_none) -> vk::PipelineStageFlags
+	{
+		auto legacy = vk::PipelineStageFlags(static_cast<VkPipelineStageFlags>(static_cast<VkPipelineStageFlags2>(stages)));
+		for (auto &&[stage, original] : legacy_stages)
+		{
+			legacy |= (stages & stage) ? original : vk::PipelineStageFlags{};
+		}
+		return legacy ? legacy : vk::PipelineStageFlags(if_none);
+	}
+
+	auto to_legacy(vk::AccessFlags2 access) -> vk::AccessFlags
+	{
+		auto legacy = vk::AccessFlags(static_cast<VkAccessFlags>(static_cast<VkAccessFlags2>(access)));
+		for (auto &&[bit, original] : legacy_access)
+		{
+			legacy |= (access & bit) ? original : vk::AccessFlags{};
+		}
+		return legacy;
+	}
+}
+
+barrier_batch::barrier_batch(devices *vkw_devices)
+	: has_synchronization2{ static_cast<bool>(vkw_devices->get_features_13().synchronization2) }
+{ }
+
+void barrier_batch::use_image(vk::Image image, const vk::ImageSubresourceRange &range, const resource_use &use, bool discard)
+{
+	auto &state = image_states[static_cast<VkImage>(image)];
+	if (discard)
+	{
+		state.layout = vk::ImageLayout::eUndefined;
+	}
+
+	auto pending = std::ranges::find(image_barriers, image, &vk::ImageMemoryBarrier2::image);
+	if (not needs_barrier(state, use, true))
+	{
+		if (pending != image_barriers.end())
+		{
+			pending->dstStageMask |= use.stages;
+			pending->dstAccessMask |= use.access;
+		}
+		state.stages |= use.stages;
+		state.access |= use.access;
+		return;
+	}
+
+	// nothing recorded since the queued barrier, so it can go straight to this use
+	if (pending != image_barriers.end())
+	{
+		assert(not (pending->dstAccessMask & write_access) and "image written before its queued barrier was flushed");
+		pending->dstStageMask = use.stages;
+		pending->dstAccessMask = use.access;
+		pending->oldLayout = discard ? vk::ImageLayout::eUndefined : pending->oldLayout;
+		pending->newLayout = use.layout;
+		state = use;
+		return;
+	}
+
+	image_barriers.push_back(
+	{
+		.srcStageMask = state.stages,
+		.srcAccessMask = state.access & write_access,
+		.dstStageMask = use.stages,
+		.dstAccessMask = use.access,
+		.oldLayout = state.layout,
+		.newLayout = use.layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = range
+	});
+	state = use;
+}
+
+void barrier_batch::use_buffer(vk::Buffer buffer, const resource_use &use)
+{
+	auto &state = buffer_states[static_cast<VkBuffer>(buffer)];
+
+	auto pending = std::ranges::find(buffer_barriers, buffer, &vk::BufferMemoryBarrier2::buffer);
+	if (not needs_barrier(state, use, false))
+	{
+		if (pending != buffer_barriers.end())
+		{
+			pending->dstStageMask |= use.stages;
+			pending->dstAccessMask |= use.access;
+		}
+		state.stages |= use.stages;
+		state.access |= use.access;
+		return;
+	}
+
+	if (pending != buffer_barriers.end())
+	{
+		assert(not (pending->dstAccessMask & write_access) and "buffer written before its queued barrier was flushed");
+		pending->dstStageMask = use.stages;
+		pending->dstAccessMask = use.access;
+		state = use;
+		return;
+	}
+
+	buffer_barriers.push_back(
+	{
+		.srcStageMask = state.stages,
+		.srcAccessMask = state.access & write_access,
+		.dstStageMask = use.stages,
+		.dstAccessMask = use.access,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE
+	});
+	state = use;
+}
+
+void barrier_batch::set_state(vk::Image image, const resource_use &use)
+{
+	assert(std::ranges::find(image_barriers, image, &vk::ImageMemoryBarrier2::image) == image_barriers.end()
+	       and "image state set with a barrier still queued");
+	image_states[static_cast<VkImage>(image)] = use;
+}
+
+void barrier_batch::set_state(vk::Buffer buffer, const resource_use &use)
+{
+	assert(std::ranges::find(buffer_barriers, buffer, &vk::BufferMemoryBarrier2::buffer) == buffer_barriers.end()
+	       and "buffer state set with a barrier still queued");
+	buffer_states[static_cast<VkBuffer>(buffer)] = use;
+}
+
+auto barrier_batch::get_state(vk::Image image) const -> std::optional<resource_use>
+{
+	auto state = image_states.find(static_cast<VkImage>(image));
+	if (state == image_states.end())
+	{
+		return std::nullopt;
+	}
+	return state->second;
+}
+
+void barrier_batch::forget(vk::Image image)
+{
+	image_states.erase(static_cast<VkImage>(image));
+	std::erase_if(image_barriers, [&](auto &&b) { return b.image == image; });
+}
+
+void barrier_batch::forget(vk::Buffer buffer)
+{
+	buffer_states.erase(static_cast<VkBuffer>(buffer));
+	std::erase_if(buffer_barriers, [&](auto &&b) { return b.buffer == buffer; });
+}
+
+void barrier_batch::flush(vk::CommandBuffer &cmd_buffer)
+{
+	if (image_barriers.empty() and buffer_barriers.empty())
+	{
+		return;
+	}
+
+	if (not has_synchronization2)
+	{
+		flush_legacy(cmd_buffer);
+		return;
+	}
+
+	auto dependency = vk::DependencyInfo
+	{
+		.bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_barriers.size()),
+		.pBufferMemoryBarriers = buffer_barriers.data(),
+		.imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size()),
+		.pImageMemoryBarriers = image_barriers.data()
+	};
+	cmd_buffer.pipelineBarrier2(dependency);
+
+	image_barriers.clear();
+	buffer_barriers.clear();
+}
+
+auto barrier_batch::size() const -> size_t
+{
+	return image_barriers.size() + buffer_barriers.size();
+}
+
+auto barrier_batch::needs_barrier(const resource_use &current, const resource_use &next, bool is_image) -> bool
+{
+	if (is_image and current.layout != next.layout)
+	{
+		return true;
+	}
+	// nothing earlier to wait for
+	if (not current.stages)
+	{
+		return false;
+	}
+	return static_cast<bool>((current.access | next.access) & write_access);
+}
+
+void barrier_batch::flush_legacy(vk::CommandBuffer &cmd_buffer)
+{
+	// one source and destination stage mask for the whole call
+	auto src_stages = vk::PipelineStageFlags{};
+	auto dst_stages = vk::PipelineStageFlags{};
+
+	auto legacy_images = std::vector<vk::ImageMemoryBarrier>{};
+	for (auto &barrier : image_barriers)
+	{
+		src_stages |= to_legacy(barrier.srcStageMask, vk::PipelineStageFlagBits::eTopOfPipe);
+		dst_stages |= to_legacy(barrier.dstStageMask, vk::PipelineStageFlagBits::eBottomOfPipe);
+		legacy_images.push_back(
+		{
+			.srcAccessMask = to_legacy(barrier.srcAccessMask),
+			.dstAccessMask = to_legacy(barrier.dstAccessMask),
+			.oldLayout = barrier.oldLayout,
+			.newLayout = barrier.newLayout,
+			.srcQueueFamilyIndex = barrier.srcQueueFamilyIndex,
+			.dstQueueFamilyIndex = barrier.dstQueueFamilyIndex,
+			.image = barrier.image,
+			.subresourceRange = barrier.subresourceRange
+		});
+	}
+
+	auto legacy_buffers = std::vector<vk::BufferMemoryBarrier>{};
+	for (auto &barrier : buffer_barriers)
+	{
+		src_stages |= to_legacy(barrier.srcStageMask, vk::PipelineStageFlagBits::eTopOfPipe);
+		dst_stages |= to_legacy(barrier.dstStageMask, vk::PipelineStageFlagBits::eBottomOfPipe);
+		legacy_buffers.push_back(
+		{
+			.srcAccessMask = to_legacy(barrier.srcAccessMask),
+			.dstAccessMask = to_legacy(barrier.dstAccessMask),
+			.srcQueueFamilyIndex = barrier.srcQueueFamilyIndex,
+			.dstQueueFamilyIndex = barrier.dstQueueFamilyIndex,
+			.buffer = barrier.buffer,
+			.offset = barrier.offset,
+			.size = barrier.size
+		});
+	}
+
+	cmd_buffer.pipelineBarrier(src_stages, dst_stages, {}, {}, legacy_buffers, legacy_images);
+
+	image_barriers.clear();
+	buffer_barriers.clear();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	class devices;
+
+	// How a resource is used: pipeline stages, memory access and, for images, the layout it needs
+	struct resource_use
+	{
+		vk::PipelineStageFlags2 stages{};
+		vk::AccessFlags2 access{};
+		vk::ImageLayout layout{vk::ImageLayout::eUndefined};  // images only
+
+		auto operator==(const resource_use &) const -> bool = default;
+	};
+
+	// Collects image and buffer barriers with synchronization2, then records them all in one pipelineBarrier2
+	// right before the commands that need them.
+	//
+	// Tracks each resource's current use, so callers only say what comes next:
+	// - reads following reads in the same layout need no barrier, they're merged into the current use
+	// - a resource used again before flush gets one barrier, from its use before the batch to the latest one
+	// - only writes are made available, earlier reads just need execution ordering
+	//
+	// State follows recording order of one command buffer at a time, so resources shared across command buffers
+	// or queues should be given their known state with set_state before use. Images are tracked as a whole.
+	// Commands using a resource may only be recorded once its queued barrier has been flushed,
+	// debug builds assert when a queued write is followed by another use before flush.
+	// Not thread safe, use one batch per recording thread.
+	//
+	// Without synchronization2 (before Vulkan 1.3), barriers are recorded with pipelineBarrier instead
+	// and stages or accesses added with synchronization2 map to the original ones covering them,
+	// e.g. shader storage write to shader write and copy to transfer. Bits with no original (video, etc.) are dropped.
+	class barrier_batch
+	{
+	public:
+		explicit barrier_batch(devices *vkw_devices);
+
+		// Next use of image. Untracked images, and any image with discard, transition from undefined.
+		void use_image(vk::Image image, const vk::ImageSubresourceRange &range, const resource_use &use, bool discard = false);
+		// Next use of whole buffer
+		void use_buffer(vk::Buffer buffer, const resource_use &use);
+
+		// Current use without recording a barrier, e.g. stage a semaphore wait happens at
+		void set_state(vk::Image image, const resource_use &use);
+		void set_state(vk::Buffer buffer, const resource_use &use);
+		[[nodiscard]] auto get_state(vk::Image image) const -> std::optional<resource_use>;
+		// Stop tracking a destroyed resource
+		void forget(vk::Image image);
+		void forget(vk::Buffer buffer);
+
+		// Records queued barriers, nothing when there are none
+		void flush(vk::CommandBuffer &cmd_buffer);
+		// number of queued barriers
+		[[nodiscard]] auto size() const -> size_t;
+
+	private:
+		// false when current use already covers next, e.g. a read after reads in the same layout
+		[[nodiscard]] static auto needs_barrier(const resource_use &current, const resource_use &next, bool is_image) -> bool;
+
+		void flush_legacy(vk::CommandBuffer &cmd_buffer);
+
+	private:
+		bool has_synchronization2{false};
+
+		std::unordered_map<VkImage, resource_use> image_states;
+		std::unordered_map<VkBuffer, resource_use> buffer_states;
+
+		std::vector<vk::ImageMemoryBarrier2> image_barriers;
+		std::vector<vk::BufferMemoryBarrier2> buffer_barriers;
+	};
+}
@@ -0,0 +1,221 @@
+#include "bindless_heap.hpp"
+
+#include "devices.hpp"
+
+using namespace vulkan_eg::vkw;
+
+namespace
+{
+	constexpr auto binding_types = std::array
+	{
+		vk::DescriptorType::eSampledImage,
+		vk::DescriptorType::eStorageBuffer,
+		vk::DescriptorType::eSampler,
+	};
+}
+
+bindless_heap::bindless_heap(devices *vkw_devices, const capacity &wanted)
+	: vk_device{ vkw_devices->get_device() }
+{
+	auto &features = vkw_devices->get_features_12();
+	if (not features.runtimeDescriptorArray
+	    or not features.descriptorBindingPartiallyBound
+	    or not features.descriptorBindingUpdateUnusedWhilePending
+	    or not features.descriptorBindingSampledImageUpdateAfterBind
+	    or not features.descriptorBindingStorageBufferUpdateAfterBind)
+	{
+		throw std::runtime_error("Bindless heap needs descriptor indexing with update-after-bind.");
+	}
+
+	// stageFlags is eAll, so per stage limits apply as well as per set ones
+	auto properties_12 = vk::PhysicalDeviceVulkan12Properties{};
+	auto properties = vk::PhysicalDeviceProperties2{ .pNext = &properties_12 };
+	vkw_devices->get_physical_device().getProperties2(&properties);
+
+	sizes = capacity
+	{
+		.sampled_images = std::min({ wanted.sampled_images,
+		                             properties_12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+		                             properties_12.maxDescriptorSetUpdateAfterBindSampledImages }),
+		.storage_buffers = std::min({ wanted.storage_buffers,
+		                              properties_12.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+		                              properties_12.maxDescriptorSetUpdateAfterBindStorageBuffers }),
+		.samplers = std::min({ wanted.samplers,
+		                       properties_12.maxPerStageDescriptorUpdateAfterBindSamplers,
+		                       properties_12.maxDescriptorSetUpdateAfterBindSamplers })
+	};
+
+	auto counts = std::array{ sizes.sampled_images, sizes.storage_buffers, sizes.samplers };
+
+	auto layout_bindings = std::vector<vk::DescriptorSetLayoutBinding>{};
+	auto binding_flags = std::vector<vk::DescriptorBindingFlags>{};
+	auto pool_sizes = std::vector<vk::DescriptorPoolSize>{};
+	for (auto &&[binding, type, count] : ranges::views::zip(ranges::views::iota(0u), binding_types, counts))
+	{
+		layout_bindings.push_back(
+		{
+			.binding = binding,
+			.descriptorType = type,
+			.descriptorCount = count,
+			.stageFlags = vk::ShaderStageFlagBits::eAll
+		});
+		binding_flags.push_back(vk::DescriptorBindingFlagBits::eUpdateAfterBind
+		                      | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending
+		                      | vk::DescriptorBindingFlagBits::ePartiallyBound);
+		pool_sizes.push_back(
+		{
+			.type = type,
+			.descriptorCount = count
+		});
+	}
+
+	auto binding_flags_ci = vk::DescriptorSetLayoutBindingFlagsCreateInfo
+	{
+		.bindingCount = static_cast<uint32_t>(binding_flags.size()),
+		.pBindingFlags = binding_flags.data()
+	};
+	auto layout_ci = vk::DescriptorSetLayoutCreateInfo
+	{
+		.pNext = &binding_flags_ci,
+		.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+		.bindingCount = static_cast<uint32_t>(layout_bindings.size()),
+		.pBindings = layout_bindings.data()
+	};
+	set_layout = vk_device.createDescriptorSetLayout(layout_ci);
+
+	auto pool_ci = vk::DescriptorPoolCreateInfo
+	{
+		.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+		.maxSets = 1,
+		.poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+		.pPoolSizes = pool_sizes.data()
+	};
+	pool = vk_device.createDescriptorPool(pool_ci);
+
+	auto set_alloc_info = vk::DescriptorSetAllocateInfo
+	{
+		.descriptorPool = pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &set_layout
+	};
+	set = vk_device.allocateDescriptorSets(set_alloc_info).front();
+}
+
+bindless_heap::~bindless_heap()
+{
+	// set goes with its pool
+	vk_device.destroyDescriptorPool(pool);
+	vk_device.destroyDescriptorSetLayout(set_layout);
+}
+
+auto bindless_heap::add_image(vk::ImageView view, vk::ImageLayout layout) -> uint32_t
+{
+	auto handle = allocate_handle(kind::sampled_image);
+
+	auto image_info = vk::DescriptorImageInfo
+	{
+		.imageView = view,
+		.imageLayout = layout
+	};
+	auto write = vk::WriteDescriptorSet
+	{
+		.dstSet = set,
+		.dstBinding = static_cast<uint32_t>(kind::sampled_image),
+		.dstArrayElement = handle,
+		.descriptorCount = 1,
+		.descriptorType = vk::DescriptorType::eSampledImage,
+		.pImageInfo = &image_info
+	};
+	vk_device.updateDescriptorSets(write, {});
+
+	return handle;
+}
+
+auto bindless_heap::add_buffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range) -> uint32_t
+{
+	auto handle = allocate_handle(kind::storage_buffer);
+
+	auto buffer_info = vk::DescriptorBufferInfo
+	{
+		.buffer = buffer,
+		.offset = offset,
+		.range = range
+	};
+	auto write = vk::WriteDescriptorSet
+	{
+		.dstSet = set,
+		.dstBinding = static_cast<uint32_t>(kind::storage_buffer),
+		.dstArrayElement = handle,
+		.descriptorCount = 1,
+		.descriptorType = vk::DescriptorType::eStorageBuffer,
+		.pBufferInfo = &buffer_info
+	};
+	vk_device.updateDescriptorSets(write, {});
+
+	return handle;
+}
+
+auto bindless_heap::add_sampler(vk::Sampler sampler) -> uint32_t
+{
+	auto handle = allocate_handle(kind::sampler);
+
+	auto image_info = vk::DescriptorImageInfo
+	{
+		.sampler = sampler
+	};
+	auto write = vk::WriteDescriptorSet
+	{
+		.dstSet = set,
+		.dstBinding = static_cast<uint32_t>(kind::sampler),
+		.dstArrayElement = handle,
+		.descriptorCount = 1,
+		.descriptorType = vk::DescriptorType::eSampler,
+		.pImageInfo = &image_info
+	};
+	vk_device.updateDescriptorSets(write, {});
+
+	return handle;
+}
+
+void bindless_heap::release(kind type, uint32_t handle)
+{
+	// descriptor is left as is, partially bound means nobody reads it until handle is reused
+	auto lock = std::scoped_lock(heap_mutex);
+	handles.at(static_cast<uint32_t>(type)).released.push_back(handle);
+}
+
+auto bindless_heap::get_set() const -> vk::DescriptorSet
+{
+	return set;
+}
+
+auto bindless_heap::get_layout() const -> vk::DescriptorSetLayout
+{
+	return set_layout;
+}
+
+auto bindless_heap::get_capacity() const -> const capacity &
+{
+	return sizes;
+}
+
+auto bindless_heap::allocate_handle(kind type) -> uint32_t
+{
+	auto capacities = std::array{ sizes.sampled_images, sizes.storage_buffers, sizes.samplers };
+	auto index = static_cast<uint32_t>(type);
+
+	auto lock = std::scoped_lock(heap_mutex);
+	auto &slot = handles.at(index);
+	if (not slot.released.empty())
+	{
+		auto handle = slot.released.back();
+		slot.released.pop_back();
+		return handle;
+	}
+
+	if (slot.next == capacities.at(index))
+	{
+		throw std::runtime_error(std::format("Bindless heap is full, binding {} holds {} descriptors.", index, slot.next));
+	}
+	return slot.next++;
+}
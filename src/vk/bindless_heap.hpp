@@ -0,0 +1,81 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	class devices;
+
+	// One global descriptor set holding every sampled image, storage buffer and sampler,
+	// each in a runtime sized array that shaders index with an integer handle:
+	//
+	//   layout(set = S, binding = 0) uniform texture2D textures[];
+	//   layout(set = S, binding = 1) buffer ... buffers[];
+	//   layout(set = S, binding = 2) uniform sampler samplers[];
+	//
+	// The set is bound once per command buffer and draws pass their handles as push constants,
+	// so adding resources or materials never allocates or binds another set.
+	// Bindings are update-after-bind and partially bound, so handles can be added while the set is
+	// bound in recorded or pending command buffers, as long as those don't use the new handles.
+	//
+	// Pipelines use it through pipeline_descriptor::external_sets, as reflection only sees the
+	// bindings one shader declares.
+	class bindless_heap
+	{
+	public:
+		// array sizes, clamped to device's update-after-bind limits
+		struct capacity
+		{
+			uint32_t sampled_images{4096};
+			uint32_t storage_buffers{4096};
+			uint32_t samplers{256};
+		};
+
+		// binding number of each array
+		enum class kind : uint32_t
+		{
+			sampled_image = 0,
+			storage_buffer = 1,
+			sampler = 2,
+		};
+
+		// Throws std::runtime_error when device lacks descriptor indexing
+		explicit bindless_heap(devices *vkw_devices, const capacity &wanted = {});
+		~bindless_heap();
+
+		bindless_heap() = delete;
+		bindless_heap(const bindless_heap &) = delete;
+		auto operator=(const bindless_heap &) -> bindless_heap & = delete;
+
+		// Returns handle, the index into that kind's array. Throws when the array is full.
+		// May be called from any thread.
+		[[nodiscard]] auto add_image(vk::ImageView view, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal) -> uint32_t;
+		[[nodiscard]] auto add_buffer(vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = VK_WHOLE_SIZE) -> uint32_t;
+		[[nodiscard]] auto add_sampler(vk::Sampler sampler) -> uint32_t;
+
+		// Handle may be handed out again right away, so only release once no frame in flight uses it
+		void release(kind type, uint32_t handle);
+
+		[[nodiscard]] auto get_set() const -> vk::DescriptorSet;
+		[[nodiscard]] auto get_layout() const -> vk::DescriptorSetLayout;
+		[[nodiscard]] auto get_capacity() const -> const capacity &;
+
+	private:
+		struct slots
+		{
+			uint32_t next{};                 // never handed out from here up
+			std::vector<uint32_t> released;
+		};
+
+		[[nodiscard]] auto allocate_handle(kind type) -> uint32_t;
+
+	private:
+		vk::Device vk_device;
+		vk::DescriptorSetLayout set_layout;
+		vk::DescriptorPool pool;
+		vk::DescriptorSet set;
+
+		capacity sizes;
+		std::array<slots, 3> handles;      // indexed by kind
+
+		std::mutex heap_mutex;
+	};
+}
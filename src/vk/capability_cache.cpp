@@ -0,0 +1,154 @@
+#include "capability_cache.hpp"
+
+#include "startup_trace.hpp"
+
+using namespace vulkan_eg::vkw;
+
+namespace
+{
+	// bump whenever the file layout changes, older files are then ignored
+	constexpr auto file_header = std::string_view("vulkan-eg-capabilities 1");
+
+	// no device comes anywhere near this, anything above means file is damaged
+	constexpr auto max_extension_count = 4096u;
+}
+
+capability_cache::capability_cache(std::filesystem::path file_path)
+	: path{ std::move(file_path) }
+{
+	load_file();
+}
+
+capability_cache::~capability_cache()
+{
+	try
+	{
+		save();
+	}
+	catch (std::exception &err)
+	{
+		std::cerr << std::format("Failed to save capability cache: {}\n", err.what());
+	}
+}
+
+auto capability_cache::get_extensions(const vk::PhysicalDevice &device) -> const std::vector<std::string> &
+{
+	auto device_key = make_key(device);
+
+	auto iter = entries.find(device_key);
+	if (iter != entries.end())
+	{
+		hit_count += iter->second.used ? 0 : 1;
+		iter->second.used = true;
+		return iter->second.extensions;
+	}
+
+	auto scope = trace_scope("vkEnumerateDeviceExtensionProperties");
+	auto extensions = std::vector<std::string>{};
+	for (auto &prop : device.enumerateDeviceExtensionProperties())
+	{
+		extensions.emplace_back(prop.extensionName.data());
+	}
+	std::ranges::sort(extensions);
+
+	miss_count++;
+	changed = true;
+	return entries.insert_or_assign(device_key, entry{ std::move(extensions), true }).first->second.extensions;
+}
+
+auto capability_cache::forget(const vk::PhysicalDevice &device) -> bool
+{
+	auto erased = entries.erase(make_key(device)) > 0;
+	changed = changed or erased;
+	return erased;
+}
+
+auto capability_cache::hits() const -> uint32_t
+{
+	return hit_count;
+}
+
+auto capability_cache::misses() const -> uint32_t
+{
+	return miss_count;
+}
+
+void capability_cache::save() const
+{
+	auto all_used = std::ranges::all_of(entries, [](auto &&item) { return item.second.used; });
+	if (path.empty() or (not changed and all_used))
+	{
+		return;
+	}
+
+	// Write next to target and rename over it, so a crash mid-write never leaves a truncated cache
+	auto temp_path = path;
+	temp_path += ".tmp";
+	{
+		auto file = std::ofstream(temp_path, std::ios::trunc);
+		if (not file.is_open())
+		{
+			throw std::runtime_error(std::format("Unable to open {}", temp_path.string()));
+		}
+
+		file << file_header << "\n";
+		for (auto &&[device_key, device_entry] : entries)
+		{
+			if (not device_entry.used)
+			{
+				continue;
+			}
+
+			auto &&[vendor_id, device_id, driver_version, api_version] = device_key;
+			file << std::format("{} {} {} {} {}\n", vendor_id, device_id, driver_version, api_version, device_entry.extensions.size());
+			for (auto &extension : device_entry.extensions)
+			{
+				file << extension << "\n";
+			}
+		}
+		if (not file)
+		{
+			throw std::runtime_error(std::format("Unable to write {}", temp_path.string()));
+		}
+	}
+
+	std::filesystem::rename(temp_path, path);
+}
+
+auto capability_cache::make_key(const vk::PhysicalDevice &device) -> key
+{
+	auto properties = device.getProperties();
+	return { properties.vendorID, properties.deviceID, properties.driverVersion, properties.apiVersion };
+}
+
+void capability_cache::load_file()
+{
+	if (path.empty() or not std::filesystem::exists(path))
+	{
+		return;
+	}
+
+	auto file = std::ifstream(path);
+	auto header = std::string{};
+	if (not std::getline(file, header) or header != file_header)
+	{
+		return;
+	}
+
+	// Entries read before any damage are kept, the damaged one and the rest are enumerated again
+	auto vendor_id = uint32_t{}, device_id = uint32_t{}, driver_version = uint32_t{}, api_version = uint32_t{}, count = uint32_t{};
+	while (file >> vendor_id >> device_id >> driver_version >> api_version >> count and count <= max_extension_count)
+	{
+		auto extensions = std::vector<std::string>(count);
+		for (auto &extension : extensions)
+		{
+			file >> extension;
+		}
+		if (not file or not std::ranges::is_sorted(extensions))
+		{
+			return;
+		}
+
+		entries.insert_or_assign(key{ vendor_id, device_id, driver_version, api_version }, entry{ std::move(extensions) });
+	}
+}
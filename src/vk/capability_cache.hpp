@@ -0,0 +1,54 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	// Device extension lists persisted to disk between runs, so startup doesn't enumerate them for every device.
+	// Entries are keyed by vendor ID, device ID, driver version and API version, so a driver update enumerates again.
+	// Extensions provided by implicit layers are cached along with the driver's own, but installing or removing
+	// a layer doesn't change the key. devices drops the entry with forget when createDevice finds an extension missing.
+	//
+	// Only entries looked up during this run are written back, so devices that are gone don't pile up.
+	class capability_cache
+	{
+	public:
+		// empty file_path keeps cache in memory only
+		explicit capability_cache(std::filesystem::path file_path);
+		~capability_cache();
+
+		capability_cache() = delete;
+		capability_cache(const capability_cache &) = delete;
+		auto operator=(const capability_cache &) -> capability_cache & = delete;
+
+		// Sorted names of extensions device supports, enumerated only when cache has no matching entry
+		[[nodiscard]] auto get_extensions(const vk::PhysicalDevice &device) -> const std::vector<std::string> &;
+
+		// Drops device's entry, so next lookup enumerates again. Returns false if there was none.
+		auto forget(const vk::PhysicalDevice &device) -> bool;
+
+		// number of devices answered from disk, and enumerated instead
+		[[nodiscard]] auto hits() const -> uint32_t;
+		[[nodiscard]] auto misses() const -> uint32_t;
+
+		// writes file when anything was enumerated or dropped since it was loaded
+		void save() const;
+
+	private:
+		using key = std::tuple<uint32_t, uint32_t, uint32_t, uint32_t>; // vendor ID, device ID, driver version, API version
+
+		struct entry
+		{
+			std::vector<std::string> extensions;
+			bool used{false};
+		};
+
+		[[nodiscard]] static auto make_key(const vk::PhysicalDevice &device) -> key;
+		void load_file();
+
+	private:
+		std::filesystem::path path;
+		std::map<key, entry> entries;
+		uint32_t hit_count{};
+		uint32_t miss_count{};
+		bool changed{false};      // entries enumerated or forgotten since load
+	};
+}
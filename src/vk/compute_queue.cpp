@@ -0,0 +1,116 @@
+#include "compute_queue.hpp"
+
+#include "devices.hpp"
+#include "timeline.hpp"
+
+using namespace vulkan_eg::vkw;
+
+compute_queue::compute_queue(devices *vkw_devices)
+	: vk_device{ vkw_devices->get_device() },
+	  vk_queue{ vkw_devices->get_compute_queue() }
+{
+	auto qf = vkw_devices->get_queue_family();
+	dedicated_queue = qf.compute_family.has_value();
+
+	auto command_pool_ci = vk::CommandPoolCreateInfo
+	{
+		.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		.queueFamilyIndex = qf.compute_family.value_or(qf.graphics_family.value())
+	};
+	command_pool = vk_device.createCommandPool(command_pool_ci);
+
+	compute_timeline = std::make_unique<timeline>(vk_device);
+}
+
+compute_queue::~compute_queue()
+{
+	compute_timeline->wait(last_value);
+
+	vk_device.destroyCommandPool(command_pool);
+	compute_timeline.reset();
+}
+
+auto compute_queue::submit(const record_function &record, std::span<const semaphore_wait> waits) -> uint64_t
+{
+	auto cmd_buffer = acquire_buffer();
+
+	cmd_buffer.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	record(cmd_buffer);
+	cmd_buffer.end();
+
+	auto wait_semaphores = std::vector<vk::Semaphore>{};
+	auto wait_values = std::vector<uint64_t>{};
+	for (auto &&[semaphore, value] : waits)
+	{
+		wait_semaphores.push_back(semaphore);
+		wait_values.push_back(value);
+	}
+	auto wait_stages = std::vector<vk::PipelineStageFlags>(waits.size(), vk::PipelineStageFlagBits::eComputeShader);
+
+	auto value = last_value + 1;
+	auto timeline_si = vk::TimelineSemaphoreSubmitInfo
+	{
+		.waitSemaphoreValueCount = static_cast<uint32_t>(wait_values.size()),
+		.pWaitSemaphoreValues = wait_values.data(),
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &value
+	};
+
+	auto submit_info = vk::SubmitInfo
+	{
+		.pNext = &timeline_si,
+		.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size()),
+		.pWaitSemaphores = wait_semaphores.data(),
+		.pWaitDstStageMask = wait_stages.data(),
+		.commandBufferCount = 1,
+		.pCommandBuffers = &cmd_buffer,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &compute_timeline->get()
+	};
+	vk_queue.submit({submit_info});
+
+	in_flight.emplace_back(value, cmd_buffer);
+	last_value = value;
+	return value;
+}
+
+auto compute_queue::submitted_value() const -> uint64_t
+{
+	return last_value;
+}
+
+auto compute_queue::get_timeline() -> timeline &
+{
+	return *compute_timeline;
+}
+
+auto compute_queue::has_dedicated_queue() const -> bool
+{
+	return dedicated_queue;
+}
+
+auto compute_queue::acquire_buffer() -> vk::CommandBuffer
+{
+	// buffers of completed submissions are reused, no waiting
+	while (not in_flight.empty() and compute_timeline->is_complete(std::get<uint64_t>(in_flight.front())))
+	{
+		free_buffers.push_back(std::get<vk::CommandBuffer>(in_flight.front()));
+		in_flight.pop_front();
+	}
+
+	if (free_buffers.empty())
+	{
+		auto cmd_buffer_alloc_info = vk::CommandBufferAllocateInfo
+		{
+			.commandPool = command_pool,
+			.level = vk::CommandBufferLevel::ePrimary,
+			.commandBufferCount = 1
+		};
+		return vk_device.allocateCommandBuffers(cmd_buffer_alloc_info).front();
+	}
+
+	auto cmd_buffer = free_buffers.back();
+	free_buffers.pop_back();
+	cmd_buffer.reset();
+	return cmd_buffer;
+}
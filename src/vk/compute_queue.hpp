@@ -0,0 +1,53 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	class devices;
+	class timeline;
+
+	// Submits compute work on the async compute queue when the device has one, otherwise on the graphics queue.
+	// Each submission signals the compute timeline. Graphics submissions wait on it for results,
+	// and compute submissions wait on other timelines (frames, uploads) for their inputs,
+	// so compute overlaps graphics work without the host waiting on either.
+	//
+	// Resources used on both queues need VK_SHARING_MODE_CONCURRENT over queue_family::get_unique_indices().
+	class compute_queue
+	{
+	public:
+		using record_function = std::function<void(vk::CommandBuffer &cmd_buffer)>;
+		using semaphore_wait = std::tuple<vk::Semaphore, uint64_t>; // timeline semaphore, value
+
+		explicit compute_queue(devices *vkw_devices);
+		~compute_queue();
+
+		compute_queue() = delete;
+		compute_queue(const compute_queue &) = delete;
+		auto operator=(const compute_queue &) -> compute_queue & = delete;
+
+		// Records into a one time command buffer and submits it, waiting on waits before any compute shader runs.
+		// Returns timeline value signalled once it has completed.
+		// When device has no compute only family, work goes on graphics queue,
+		// so call this from the thread that submits to graphics queue.
+		auto submit(const record_function &record, std::span<const semaphore_wait> waits = {}) -> uint64_t;
+
+		// value of last submission, 0 if nothing was ever submitted
+		[[nodiscard]] auto submitted_value() const -> uint64_t;
+		[[nodiscard]] auto get_timeline() -> timeline &;
+		[[nodiscard]] auto has_dedicated_queue() const -> bool;
+
+	private:
+		[[nodiscard]] auto acquire_buffer() -> vk::CommandBuffer;
+
+	private:
+		vk::Device vk_device;
+		vk::Queue vk_queue;
+		std::unique_ptr<timeline> compute_timeline;
+
+		vk::CommandPool command_pool;
+		std::vector<vk::CommandBuffer> free_buffers;
+		std::deque<std::tuple<uint64_t, vk::CommandBuffer>> in_flight; // signalled value, buffer
+
+		bool dedicated_queue{false};
+		uint64_t last_value{};
+	};
+}
@@ -2,37 +2,43 @@
 
 #include "instance.hpp"
 #include "swap_chain.hpp"
+#include "capability_cache.hpp"
+#include "startup_trace.hpp"
 
 using namespace vulkan_eg::vkw;
 
 namespace
 {
-	const auto wanted_device_extensions = std::vector
+	const auto presentable_device_extensions = std::vector
 	{
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 	};
 
-	auto check_device_extension_support(const vk::PhysicalDevice &device, const std::vector<const char *> &extensions) -> bool
+	const auto headless_device_extensions = std::vector<const char *>{};
+
+	// Without a surface there is nothing to present, so swap chain support is not needed.
+	auto get_wanted_device_extensions(const vk::SurfaceKHR &surface) -> const std::vector<const char *> &
 	{
-		auto device_exts = device.enumerateDeviceExtensionProperties(); 
-		auto trans_view = device_exts
-		                | std::views::transform([](const vk::ExtensionProperties &prop) -> const char *
-		{
-			return prop.extensionName.data();
-		});
-		auto supported_extensions = std::vector(std::begin(trans_view), std::end(trans_view));
-		std::ranges::sort(supported_extensions, [](const char *a, const char *b)
+		return surface ? presentable_device_extensions 
+		               : headless_device_extensions;
+	}
+
+	// supported_extensions must be sorted, as capability_cache returns them
+	auto check_device_extension_support(const std::vector<std::string> &supported_extensions, const std::vector<const char *> &extensions) -> bool
+	{
+		// set_intersection needs both ranges sorted by the same less than comparison it is given
+		auto wanted_extensions = extensions;
+		std::ranges::sort(wanted_extensions, [](const char *a, const char *b)
 		{
 			return std::string_view(a) < std::string_view(b);
 		});
 
 		auto intersection = std::vector<const char *>{};
-		std::ranges::set_intersection(extensions, supported_extensions, std::back_inserter(intersection), [](const char *a, const char *b)
-		{
-			return std::string_view(a) == std::string_view(b);
-		});
+		std::ranges::set_intersection(wanted_extensions, supported_extensions, std::back_inserter(intersection), std::ranges::less{},
+		                              [](const char *name) { return std::string_view(name); },
+		                              [](const std::string &name) { return std::string_view(name); });
 
-		return (intersection.size() == extensions.size());
+		return (intersection.size() == wanted_extensions.size());
 	}
 
 	auto find_queue_family(const vk::PhysicalDevice &device, const vk::SurfaceKHR &surface) -> queue_family
@@ -51,6 +57,37 @@ namespace
 			out.graphics_family = static_cast<uint32_t>(std::distance(queue_families.begin(), queue_family_iter));
 		}
 
+		// Transfer only families are usually backed by copy engines, which run alongside graphics work
+		queue_family_iter = std::ranges::find_if(queue_families, [&](vk::QueueFamilyProperties &qf) -> bool
+		{
+			return static_cast<bool>(qf.queueFlags & vk::QueueFlagBits::eTransfer)
+			   and not (qf.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));
+		});
+
+		if (queue_family_iter != queue_families.end())
+		{
+			out.transfer_family = static_cast<uint32_t>(std::distance(queue_families.begin(), queue_family_iter));
+		}
+
+		// Compute families without graphics run their work alongside the graphics queue
+		queue_family_iter = std::ranges::find_if(queue_families, [&](vk::QueueFamilyProperties &qf) -> bool
+		{
+			return static_cast<bool>(qf.queueFlags & vk::QueueFlagBits::eCompute)
+			   and not (qf.queueFlags & vk::QueueFlagBits::eGraphics);
+		});
+
+		if (queue_family_iter != queue_families.end())
+		{
+			out.compute_family = static_cast<uint32_t>(std::distance(queue_families.begin(), queue_family_iter));
+		}
+
+		// Headless, nothing gets presented so present queue is just the graphics queue.
+		if (not surface)
+		{
+			out.present_family = out.graphics_family;
+			return out;
+		}
+
 		auto queue_idx{0};
 		queue_family_iter = std::ranges::find_if(queue_families, [&](vk::QueueFamilyProperties &qf) -> bool
 		{
@@ -67,6 +104,81 @@ namespace
 		
 		return out;
 	}
+
+	// largest device local heap, VRAM on discrete devices and a share of system memory on integrated ones
+	auto device_local_bytes(const vk::PhysicalDevice &device) -> vk::DeviceSize
+	{
+		auto memory = device.getMemoryProperties();
+		auto heaps = std::span(memory.memoryHeaps.data(), memory.memoryHeapCount);
+
+		auto out = vk::DeviceSize{};
+		for (auto &heap : heaps)
+		{
+			if (heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+			{
+				out = std::max(out, heap.size);
+			}
+		}
+		return out;
+	}
+
+	// Device type decides, the rest only orders devices of the same type:
+	// 100 per GiB of VRAM up to 32 GiB, 500 per optional feature renderer makes use of,
+	// and 250 per dedicated transfer or compute family, which run alongside graphics.
+	auto score_device(const vk::PhysicalDevice &device, const vk::PhysicalDeviceProperties &properties, const queue_family &families) -> uint32_t
+	{
+		constexpr auto type_weight = 10'000u;
+		constexpr auto max_vram_gib = vk::DeviceSize{32};
+
+		auto type_rank = [&]() -> uint32_t
+		{
+			switch (properties.deviceType)
+			{
+				case vk::PhysicalDeviceType::eDiscreteGpu:   return 4;
+				case vk::PhysicalDeviceType::eIntegratedGpu: return 3;
+				case vk::PhysicalDeviceType::eVirtualGpu:    return 2;
+				case vk::PhysicalDeviceType::eCpu:           return 1;
+				default:                                     return 0;
+			}
+		}();
+		auto score = type_rank * type_weight;
+
+		score += static_cast<uint32_t>(std::min(device_local_bytes(device) >> 30, max_vram_gib)) * 100;
+
+		// 1.3 features struct may only be chained on devices that know it
+		auto is_13 = properties.apiVersion >= VK_API_VERSION_1_3;
+		auto supported_13 = vk::PhysicalDeviceVulkan13Features{};
+		auto supported_12 = vk::PhysicalDeviceVulkan12Features{ .pNext = is_13 ? &supported_13 : nullptr };
+		auto supported = vk::PhysicalDeviceFeatures2{ .pNext = &supported_12 };
+		device.getFeatures2(&supported);
+
+		auto optional_features = std::array
+		{
+			supported_12.drawIndirectCount,
+			supported_12.runtimeDescriptorArray & supported_12.descriptorBindingPartiallyBound,
+			supported_13.synchronization2,
+			supported_13.dynamicRendering,
+		};
+		score += static_cast<uint32_t>(std::ranges::count(optional_features, VK_TRUE)) * 500;
+
+		score += families.transfer_family.has_value() ? 250 : 0;
+		score += families.compute_family.has_value() ? 250 : 0;
+
+		return score;
+	}
+
+	// all digits is an index into device list, anything else a case insensitive part of device name
+	auto matches_preference(std::string_view preferred, size_t index, const vk::PhysicalDeviceProperties &properties) -> bool
+	{
+		if (std::ranges::all_of(preferred, [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }))
+		{
+			return std::to_string(index) == preferred;
+		}
+
+		auto lower = [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); };
+		auto name = std::string_view(properties.deviceName.data());
+		return not std::ranges::search(name | std::views::transform(lower), preferred | std::views::transform(lower)).empty();
+	}
 }
 
 auto queue_family::is_complete() const -> bool
@@ -78,7 +190,8 @@ auto queue_family::is_complete() const -> bool
 auto queue_family::get_array() const -> std::vector<vk::DeviceQueueCreateInfo>
 {
 	auto out = std::vector<vk::DeviceQueueCreateInfo>{};
-	auto queue_priority = 1.0f;
+	// referenced by returned create infos, so it has to outlive this call
+	static const auto queue_priority = 1.0f;
 
 	if (graphics_family.has_value())
 	{
@@ -100,13 +213,52 @@ auto queue_family::get_array() const -> std::vector<vk::DeviceQueueCreateInfo>
 		});
 	}
 
+	// never a graphics family, but could in principle be the present family
+	if (transfer_family.has_value() and transfer_family != present_family)
+	{
+		out.emplace_back(vk::DeviceQueueCreateInfo
+		{
+			.queueFamilyIndex = static_cast<uint32_t>(transfer_family.value()),
+			.queueCount = 1,
+			.pQueuePriorities = &queue_priority
+		});
+	}
+
+	// transfer family has no compute, so only present family can overlap
+	if (compute_family.has_value() and compute_family != present_family)
+	{
+		out.emplace_back(vk::DeviceQueueCreateInfo
+		{
+			.queueFamilyIndex = static_cast<uint32_t>(compute_family.value()),
+			.queueCount = 1,
+			.pQueuePriorities = &queue_priority
+		});
+	}
+
+	return out;
+}
+
+auto queue_family::get_unique_indices() const -> std::vector<uint32_t>
+{
+	auto out = std::vector<uint32_t>{};
+	for (auto &family : { graphics_family, present_family, transfer_family, compute_family })
+	{
+		if (family.has_value() and std::ranges::find(out, family.value()) == out.end())
+		{
+			out.push_back(family.value());
+		}
+	}
 	return out;
 }
 
-devices::devices(const instance *vkw_inst)
+devices::devices(const instance *vkw_inst, const device_selection &selection)
 {
-	pick_physical_device(vkw_inst);
-	create_logical_device(vkw_inst);
+	auto capabilities = capability_cache(selection.capability_cache_path);
+	pick_physical_device(vkw_inst, selection, capabilities);
+	create_logical_device(vkw_inst, capabilities);
+	// after logical device, a stale cache entry is enumerated again there
+	choice.capabilities_cached = capabilities.hits();
+	choice.capabilities_enumerated = capabilities.misses();
 }
 
 devices::~devices()
@@ -115,55 +267,161 @@ devices::~devices()
 	vk_logical_device = nullptr;
 }
 
-void devices::pick_physical_device(const instance *vkw_inst)
+void devices::pick_physical_device(const instance *vkw_inst, const device_selection &selection, capability_cache &capabilities)
 {
+	auto scope = trace_scope("devices::pick_physical_device");
 	auto &&[instance, surface] = vkw_inst->get();
 
+	auto preferred = selection.preferred;
+	if (auto env_device = std::getenv("VULKAN_EG_DEVICE"); preferred.empty() and env_device != nullptr)
+	{
+		preferred = env_device;
+	}
+
+	// Everything here comes from properties or capability cache. Surface queries are
+	// left for the loop below, which only runs them until the best candidate passes.
 	auto physical_devices = instance.enumeratePhysicalDevices();
-	auto suitable_device_iter = std::ranges::find_if(physical_devices, [&](vk::PhysicalDevice &device)
+	auto candidates = std::vector<std::tuple<uint32_t, vk::PhysicalDevice, vk::PhysicalDeviceProperties>>{};
+	for (auto &&[index, device] : ranges::views::enumerate(physical_devices))
 	{
-		auto srfc_dtls = query_surface_details(device, surface);
-		auto exts_supported = check_device_extension_support(device, wanted_device_extensions);
-		auto que_fam = find_queue_family(device, surface);
+		auto properties = device.getProperties();
 
-		return que_fam.is_complete()
-		   and exts_supported
-		   and not srfc_dtls.formats.empty()
-		   and not srfc_dtls.present_modes.empty();
-	});
-	if (suitable_device_iter == physical_devices.end())
+		// timeline semaphores are core in 1.2
+		if (properties.apiVersion < VK_API_VERSION_1_2)
+		{
+			continue;
+		}
+
+		if (not preferred.empty() and not matches_preference(preferred, static_cast<size_t>(index), properties))
+		{
+			continue;
+		}
+
+		if (not check_device_extension_support(capabilities.get_extensions(device), get_wanted_device_extensions(surface)))
+		{
+			continue;
+		}
+
+		// without surface, so present support isn't queried yet
+		auto families = find_queue_family(device, {});
+		if (not families.graphics_family.has_value())
+		{
+			continue;
+		}
+
+		candidates.emplace_back(score_device(device, properties, families), device, properties);
+	}
+	std::ranges::stable_sort(candidates, std::ranges::greater{}, [](auto &&candidate) { return std::get<uint32_t>(candidate); });
+
+	for (auto &&[score, device, properties] : candidates)
+	{
+		auto families = find_queue_family(device, surface);
+		if (not families.is_complete())
+		{
+			continue;
+		}
+
+		if (surface)
+		{
+			auto srfc_dtls = query_surface_details(device, surface);
+			if (srfc_dtls.formats.empty() or srfc_dtls.present_modes.empty())
+			{
+				continue;
+			}
+		}
+
+		vk_physical_device = device;
+		qf = families;
+		choice.name = properties.deviceName.data();
+		choice.type = properties.deviceType;
+		choice.score = score;
+		return;
+	}
+
+	if (not preferred.empty())
 	{
-		throw std::runtime_error("Cannot find suitable physical device.");
+		throw std::runtime_error(std::format("Cannot find suitable physical device matching \"{}\".", preferred));
 	}
-	vk_physical_device = *suitable_device_iter;
+	throw std::runtime_error("Cannot find suitable physical device.");
 }
 
-void devices::create_logical_device(const instance *vkw_inst)
+void devices::create_logical_device(const instance *vkw_inst, capability_cache &capabilities)
 {
+	auto scope = trace_scope("devices::create_logical_device");
 	auto &&[instance, surface] = vkw_inst->get();
-	qf = find_queue_family(vk_physical_device, surface);
-
 	auto queue_array = qf.get_array();
 
 	auto layers = vkw_inst->get_layers();
-	auto extensions = wanted_device_extensions;
-	auto device_features = vk::PhysicalDeviceFeatures{};
+	auto extensions = get_wanted_device_extensions(surface);
+
+	// optional features are enabled whenever supported, users check get_features() before relying on them
+	// 1.3 features struct may only be chained on devices that know it
+	auto is_13 = vk_physical_device.getProperties().apiVersion >= VK_API_VERSION_1_3;
+	auto supported_13 = vk::PhysicalDeviceVulkan13Features{};
+	auto supported_12 = vk::PhysicalDeviceVulkan12Features{ .pNext = is_13 ? &supported_13 : nullptr };
+	auto supported = vk::PhysicalDeviceFeatures2{ .pNext = &supported_12 };
+	vk_physical_device.getFeatures2(&supported);
+
+	enabled_features = vk::PhysicalDeviceFeatures
+	{
+		.drawIndirectFirstInstance = supported.features.drawIndirectFirstInstance
+	};
+	enabled_features_12 = vk::PhysicalDeviceVulkan12Features
+	{
+		.drawIndirectCount = supported_12.drawIndirectCount,
+		// bindless_heap: runtime sized arrays indexed by handle, written while bound
+		.descriptorIndexing = supported_12.descriptorIndexing,
+		.shaderSampledImageArrayNonUniformIndexing = supported_12.shaderSampledImageArrayNonUniformIndexing,
+		.shaderStorageBufferArrayNonUniformIndexing = supported_12.shaderStorageBufferArrayNonUniformIndexing,
+		.descriptorBindingSampledImageUpdateAfterBind = supported_12.descriptorBindingSampledImageUpdateAfterBind,
+		.descriptorBindingStorageBufferUpdateAfterBind = supported_12.descriptorBindingStorageBufferUpdateAfterBind,
+		.descriptorBindingUpdateUnusedWhilePending = supported_12.descriptorBindingUpdateUnusedWhilePending,
+		.descriptorBindingPartiallyBound = supported_12.descriptorBindingPartiallyBound,
+		.runtimeDescriptorArray = supported_12.runtimeDescriptorArray,
+		.timelineSemaphore = true
+	};
+	enabled_features_13 = vk::PhysicalDeviceVulkan13Features
+	{
+		.synchronization2 = supported_13.synchronization2,
+		.dynamicRendering = supported_13.dynamicRendering
+	};
+	enabled_features_12.pNext = is_13 ? &enabled_features_13 : nullptr;
 
 	auto device_createInfo = vk::DeviceCreateInfo
 	{
+		.pNext = &enabled_features_12,
 		.queueCreateInfoCount = static_cast<uint32_t>(queue_array.size()),
 		.pQueueCreateInfos = queue_array.data(),
 		.enabledLayerCount = static_cast<uint32_t>(layers.size()),
 		.ppEnabledLayerNames = layers.data(),
 		.enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
 		.ppEnabledExtensionNames = extensions.data(),
-        .pEnabledFeatures = &device_features
+        .pEnabledFeatures = &enabled_features
 	};
 
-	vk_logical_device = vk_physical_device.createDevice(device_createInfo);
+	try
+	{
+		auto create_scope = trace_scope("vkCreateDevice");
+		vk_logical_device = vk_physical_device.createDevice(device_createInfo);
+	}
+	catch (vk::ExtensionNotPresentError &)
+	{
+		// Cached list may still have extensions of an implicit layer removed since, enumerate again.
+		// Device was picked by the stale list, so only retry if it really supports what's needed.
+		if (not capabilities.forget(vk_physical_device)
+		    or not check_device_extension_support(capabilities.get_extensions(vk_physical_device), extensions))
+		{
+			throw;
+		}
+		vk_logical_device = vk_physical_device.createDevice(device_createInfo);
+	}
 
 	vk_graphics_queue = vk_logical_device.getQueue(qf.graphics_family.value(), 0);
 	vk_present_queue = vk_logical_device.getQueue(qf.present_family.value(), 0);
+	vk_transfer_queue = qf.transfer_family.has_value() ? vk_logical_device.getQueue(qf.transfer_family.value(), 0)
+	                                                   : vk_graphics_queue;
+	vk_compute_queue = qf.compute_family.has_value() ? vk_logical_device.getQueue(qf.compute_family.value(), 0)
+	                                                 : vk_graphics_queue;
 }
 
 auto devices::get_queue_family() const -> queue_family
@@ -181,6 +439,11 @@ auto devices::get_physical_device() -> vk::PhysicalDevice &
 	return vk_physical_device;
 }
 
+auto devices::get_choice() const -> const device_choice &
+{
+	return choice;
+}
+
 auto devices::get_queues() -> std::tuple<vk::Queue &, vk::Queue &>
 {
 	return
@@ -188,4 +451,29 @@ auto devices::get_queues() -> std::tuple<vk::Queue &, vk::Queue &>
 		vk_graphics_queue,
 		vk_present_queue
 	};
-}
\ No newline at end of file
+}
+
+auto devices::get_features() const -> const vk::PhysicalDeviceFeatures &
+{
+	return enabled_features;
+}
+
+auto devices::get_features_12() const -> const vk::PhysicalDeviceVulkan12Features &
+{
+	return enabled_features_12;
+}
+
+auto devices::get_features_13() const -> const vk::PhysicalDeviceVulkan13Features &
+{
+	return enabled_features_13;
+}
+
+auto devices::get_transfer_queue() -> vk::Queue &
+{
+	return vk_transfer_queue;
+}
+
+auto devices::get_compute_queue() -> vk::Queue &
+{
+	return vk_compute_queue;
+}
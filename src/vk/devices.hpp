@@ -3,20 +3,44 @@
 namespace vulkan_eg::vkw
 {
 	class instance;
+	class capability_cache;
 
 	struct queue_family
 	{
 		std::optional<uint32_t> graphics_family;
 		std::optional<uint32_t> present_family;
+		std::optional<uint32_t> transfer_family; // transfer only (DMA) family, if device has one
+		std::optional<uint32_t> compute_family;  // compute without graphics (async compute), if device has one
 
 		[[nodiscard]] auto is_complete() const -> bool;
 		[[nodiscard]] auto get_array() const -> std::vector<vk::DeviceQueueCreateInfo>;
+		// every distinct family, for resources with VK_SHARING_MODE_CONCURRENT
+		[[nodiscard]] auto get_unique_indices() const -> std::vector<uint32_t>;
+	};
+
+	// How devices picks a physical device.
+	// Suitable devices are scored and the highest wins, unless one is asked for by preferred
+	// or, when preferred is empty, by the VULKAN_EG_DEVICE environment variable.
+	struct device_selection
+	{
+		std::string preferred{};                       // index into instance's device list, or part of device name
+		std::filesystem::path capability_cache_path{}; // empty keeps device capabilities in memory only
+	};
+
+	// Which physical device devices picked and why, for the application to report
+	struct device_choice
+	{
+		std::string name{};
+		vk::PhysicalDeviceType type{};
+		uint32_t score{};
+		uint32_t capabilities_cached{};     // devices whose extensions came from capability cache
+		uint32_t capabilities_enumerated{}; // devices whose extensions had to be enumerated
 	};
 
 	class devices
 	{
 	public:
-		explicit devices(const instance *vkw_inst);
+		explicit devices(const instance *vkw_inst, const device_selection &selection = {});
 		~devices();
 
 		devices() = delete;
@@ -24,16 +48,30 @@ namespace vulkan_eg::vkw
 		[[nodiscard]] auto get_queue_family() const -> queue_family;
 		auto get_device() -> vk::Device &;
 		auto get_physical_device() -> vk::PhysicalDevice &;
+		[[nodiscard]] auto get_choice() const -> const device_choice &;
+		// features enabled on logical device
+		[[nodiscard]] auto get_features() const -> const vk::PhysicalDeviceFeatures &;
+		[[nodiscard]] auto get_features_12() const -> const vk::PhysicalDeviceVulkan12Features &;
+		// all false on devices older than Vulkan 1.3
+		[[nodiscard]] auto get_features_13() const -> const vk::PhysicalDeviceVulkan13Features &;
 		auto get_queues() -> std::tuple<vk::Queue &, vk::Queue &>;
+		// dedicated transfer queue, or graphics queue when device has no transfer only family
+		auto get_transfer_queue() -> vk::Queue &;
+		// async compute queue, or graphics queue when device has no compute only family
+		auto get_compute_queue() -> vk::Queue &;
 
 	private:
-		void pick_physical_device(const instance *vkw_inst);
-		void create_logical_device(const instance *vkw_inst);
+		void pick_physical_device(const instance *vkw_inst, const device_selection &selection, capability_cache &capabilities);
+		void create_logical_device(const instance *vkw_inst, capability_cache &capabilities);
 
 	private:
 		vk::PhysicalDevice vk_physical_device;
 		vk::Device vk_logical_device;
-		vk::Queue vk_graphics_queue, vk_present_queue;
+		vk::Queue vk_graphics_queue, vk_present_queue, vk_transfer_queue, vk_compute_queue;
 		queue_family qf;
+		device_choice choice;
+		vk::PhysicalDeviceFeatures enabled_features;
+		vk::PhysicalDeviceVulkan12Features enabled_features_12;
+		vk::PhysicalDeviceVulkan13Features enabled_features_13;
 	};
 }
@@ -0,0 +1,139 @@
+#include "gpu_timer.hpp"
+
+#include "devices.hpp"
+
+using namespace vulkan_eg::vkw;
+
+namespace
+{
+	constexpr auto queries_per_scope = 2u;
+}
+
+gpu_timer::gpu_timer(devices *vkw_devices, uint32_t frame_count, uint32_t max_scopes)
+	: max_scopes{ max_scopes }
+{
+	vk_device = vkw_devices->get_device();
+
+	auto physical_device = vkw_devices->get_physical_device();
+	auto graphics_family = vkw_devices->get_queue_family().graphics_family.value();
+	auto valid_bits = physical_device.getQueueFamilyProperties().at(graphics_family).timestampValidBits;
+
+	timestamp_period = physical_device.getProperties().limits.timestampPeriod;
+	timestamp_mask = (valid_bits >= 64) ? UINT64_MAX : ((uint64_t{1} << valid_bits) - 1);
+	if (valid_bits == 0)
+	{
+		timestamp_mask = 0;
+	}
+
+	frames.resize(frame_count);
+	if (not is_supported())
+	{
+		return;
+	}
+
+	for (auto &frame : frames)
+	{
+		auto query_pool_ci = vk::QueryPoolCreateInfo
+		{
+			.queryType = vk::QueryType::eTimestamp,
+			.queryCount = max_scopes * queries_per_scope
+		};
+		frame.pool = vk_device.createQueryPool(query_pool_ci);
+	}
+}
+
+gpu_timer::~gpu_timer()
+{
+	for (auto &frame : frames)
+	{
+		if (frame.pool)
+		{
+			vk_device.destroyQueryPool(frame.pool);
+			frame.pool = nullptr;
+		}
+	}
+}
+
+void gpu_timer::begin_frame(vk::CommandBuffer &cmd_buffer, uint32_t frame_index, bool enabled)
+{
+	active_frame = frame_index;
+
+	auto &frame = frames.at(active_frame);
+	frame.scope_names.clear();
+	frame.pending = enabled and is_supported();
+
+	if (frame.pending)
+	{
+		cmd_buffer.resetQueryPool(frame.pool, 0, max_scopes * queries_per_scope);
+	}
+}
+
+auto gpu_timer::begin_scope(vk::CommandBuffer &cmd_buffer, std::string_view name) -> uint32_t
+{
+	auto &frame = frames.at(active_frame);
+	auto scope = static_cast<uint32_t>(frame.scope_names.size());
+	if (not frame.pending or scope >= max_scopes)
+	{
+		return max_scopes;
+	}
+
+	frame.scope_names.emplace_back(name);
+	cmd_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame.pool, scope * queries_per_scope);
+
+	return scope;
+}
+
+void gpu_timer::end_scope(vk::CommandBuffer &cmd_buffer, uint32_t scope)
+{
+	auto &frame = frames.at(active_frame);
+	if (not frame.pending or scope >= max_scopes)
+	{
+		return;
+	}
+
+	cmd_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, frame.pool, scope * queries_per_scope + 1);
+}
+
+void gpu_timer::resolve(uint32_t frame_index)
+{
+	auto &frame = frames.at(frame_index);
+	if (not frame.pending or frame.scope_names.empty())
+	{
+		return;
+	}
+
+	auto query_count = static_cast<uint32_t>(frame.scope_names.size()) * queries_per_scope;
+	auto timestamps = std::vector<uint64_t>(query_count);
+
+	// No wait flag, frame's fence has already signalled so results should be available.
+	// If they are not, skip this frame rather than block.
+	auto result = vk_device.getQueryPoolResults(frame.pool, 0, query_count,
+	                                            timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+	                                            vk::QueryResultFlagBits::e64);
+	if (result != vk::Result::eSuccess)
+	{
+		return;
+	}
+	frame.pending = false;
+
+	results.clear();
+	for (auto &&[i, name] : ranges::views::enumerate(frame.scope_names))
+	{
+		auto begin = timestamps.at(i * queries_per_scope) & timestamp_mask;
+		auto end = timestamps.at(i * queries_per_scope + 1) & timestamp_mask;
+		auto ticks = (end >= begin) ? end - begin : 0;
+
+		results.emplace_back(name, static_cast<double>(ticks) * timestamp_period / 1'000'000.0);
+	}
+}
+
+auto gpu_timer::get_results() const -> const scope_results &
+{
+	return results;
+}
+
+auto gpu_timer::is_supported() const -> bool
+{
+	return timestamp_mask != 0 
+	   and timestamp_period > 0.0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	class devices;
+
+	// Timestamp queries around named scopes, with one query pool per frame in flight.
+	// Results are only read back once the frame that wrote them is known to be complete,
+	// so collecting them never stalls the CPU.
+	class gpu_timer
+	{
+	public:
+		using scope_results = std::vector<std::tuple<std::string, double>>;
+
+		gpu_timer(devices *vkw_devices, uint32_t frame_count, uint32_t max_scopes = 32);
+		~gpu_timer();
+
+		gpu_timer() = delete;
+
+		// must be recorded outside of a render pass, resets frame's queries.
+		// when not enabled, scopes in this command buffer are not timed 
+		// (e.g. buffers that are submitted more than once)
+		void begin_frame(vk::CommandBuffer &cmd_buffer, uint32_t frame_index, bool enabled = true);
+		[[nodiscard]] auto begin_scope(vk::CommandBuffer &cmd_buffer, std::string_view name) -> uint32_t;
+		void end_scope(vk::CommandBuffer &cmd_buffer, uint32_t scope);
+
+		// call only once the frame that last used frame_index has completed
+		void resolve(uint32_t frame_index);
+
+		// name and duration in milliseconds of each scope in last resolved frame
+		[[nodiscard]] auto get_results() const -> const scope_results &;
+		[[nodiscard]] auto is_supported() const -> bool;
+
+	private:
+		struct frame_queries
+		{
+			vk::QueryPool pool;
+			std::vector<std::string> scope_names;
+			bool pending{false};
+		};
+
+		vk::Device vk_device;
+		std::vector<frame_queries> frames;
+		uint32_t max_scopes{};
+		uint32_t active_frame{};
+		uint64_t timestamp_mask{};
+		double timestamp_period{};
+		scope_results results;
+	};
+}
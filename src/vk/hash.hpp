@@ -0,0 +1,26 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	inline void hash_combine(size_t &seed, size_t value)
+	{
+		seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+	}
+
+	template <typename T>
+	inline void hash_combine(size_t &seed, const T &value)
+	{
+		hash_combine(seed, std::hash<T>{}(value));
+	}
+
+	// FNV-1a, for SPIR-V and other word blobs
+	inline auto hash_words(std::span<const uint32_t> words) -> size_t
+	{
+		auto h = uint64_t{ 0xcbf29ce484222325ull };
+		for (auto word : words)
+		{
+			h = (h ^ word) * 0x100000001b3ull;
+		}
+		return static_cast<size_t>(h);
+	}
+}
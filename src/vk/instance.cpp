@@ -1,5 +1,7 @@
 #include "instance.hpp"
 
+#include "startup_trace.hpp"
+
 using namespace vulkan_eg::vkw;
 
 namespace
@@ -8,7 +10,9 @@ namespace
 		auto exts = std::vector<std::string>
 		{
 			VK_KHR_SURFACE_EXTENSION_NAME,
+		#ifdef VK_USE_PLATFORM_WIN32_KHR
 			VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
+		#endif
 		#ifdef _DEBUG
 			VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
 			VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
@@ -59,14 +63,13 @@ namespace
 		return out;
 	}
 
-	auto convert_to_vec_char(std::vector<std::string> &in) -> std::vector<const char *>
+	// pointers stay valid as long as in is neither changed nor destroyed
+	auto convert_to_vec_char(const std::vector<std::string> &in) -> std::vector<const char *>
 	{
 		auto out = std::vector<const char *>{};
-		std::ranges::transform(in, std::back_inserter(out), [](std::string &s)
+		std::ranges::transform(in, std::back_inserter(out), [](const std::string &s)
 		{
-			auto c_str = new char[s.size()];
-			std::strcpy(c_str, s.c_str());
-			return c_str;
+			return s.c_str();
 		});
 		return out;
 	}
@@ -114,20 +117,31 @@ static void vkDestroyDebugUtilsMessengerEXT(VkInstance instance,
 
 #endif
 
-instance::instance(std::string_view name, std::string_view engine, uint32_t version, HWND window_handle)
+instance::instance(std::string_view name, std::string_view engine, uint32_t version)
 {
+	auto scope = trace_scope("instance::instance");
 	create_instance(name, engine, version);
 
 #ifdef _DEBUG
 	setup_debug_callback();
 #endif
+}
+
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+instance::instance(std::string_view name, std::string_view engine, uint32_t version, HWND window_handle)
+	: instance(name, engine, version)
+{
 	create_surface(window_handle);
 }
+#endif
 
 instance::~instance()
 {
-	vk_instance.destroySurfaceKHR(vk_surface);
-	vk_surface = nullptr;
+	if (vk_surface)
+	{
+		vk_instance.destroySurfaceKHR(vk_surface);
+		vk_surface = nullptr;
+	}
 
 #ifdef _DEBUG
 	vk_instance.destroyDebugUtilsMessengerEXT(debug_messenger);
@@ -149,24 +163,26 @@ void instance::create_instance(std::string_view name, std::string_view engine, u
 		.apiVersion = VK_API_VERSION_1_3
 	};
 
-	auto installed_extensions = get_installed_extensions();
-	auto available_extensions = std::vector<std::string>{};
-	std::ranges::set_intersection(installed_extensions, wanted_instance_extensions, std::back_inserter(available_extensions));
-	auto exts = convert_to_vec_char(available_extensions);
-
-	auto lyrs = get_layers();
+	{
+		auto scope = trace_scope("instance: enumerate layers and extensions");
+		std::ranges::set_intersection(get_installed_extensions(), wanted_instance_extensions, std::back_inserter(enabled_extensions));
+		std::ranges::set_intersection(get_installed_layers(), wanted_instance_layers, std::back_inserter(enabled_layers));
+		layer_names = convert_to_vec_char(enabled_layers);
+	}
+	auto exts = convert_to_vec_char(enabled_extensions);
 
 	auto create_info = vk::InstanceCreateInfo
 	{
 		.pApplicationInfo = &app_info,
-		.enabledLayerCount = static_cast<uint32_t>(lyrs.size()),
-		.ppEnabledLayerNames = lyrs.data(),
+		.enabledLayerCount = static_cast<uint32_t>(layer_names.size()),
+		.ppEnabledLayerNames = layer_names.data(),
 		.enabledExtensionCount = static_cast<uint32_t>(exts.size()),
 		.ppEnabledExtensionNames = exts.data()
 	};
 
 	try 
 	{
+		auto scope = trace_scope("vkCreateInstance");
 		vk_instance = vk::createInstance(create_info);
 	}
 	catch(vk::SystemError &err)
@@ -178,6 +194,7 @@ void instance::create_instance(std::string_view name, std::string_view engine, u
 
 void instance::setup_debug_callback()
 {
+	auto scope = trace_scope("instance::setup_debug_callback");
 	auto createInfo = vk::DebugUtilsMessengerCreateInfoEXT
 	{
 		.messageSeverity = {
@@ -195,8 +212,10 @@ void instance::setup_debug_callback()
 	debug_messenger = vk_instance.createDebugUtilsMessengerEXT(createInfo);
 }
 
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 void instance::create_surface(HWND window_handle)
 {
+	auto scope = trace_scope("instance::create_surface");
 	auto create_info = vk::Win32SurfaceCreateInfoKHR
 	{
 		.hinstance = GetModuleHandle(nullptr),
@@ -205,6 +224,7 @@ void instance::create_surface(HWND window_handle)
 
 	vk_surface = vk_instance.createWin32SurfaceKHR(create_info);
 }
+#endif
 
 auto instance::get() const -> std::tuple<const vk::Instance &, const vk::SurfaceKHR &>
 {
@@ -215,12 +235,7 @@ auto instance::get() const -> std::tuple<const vk::Instance &, const vk::Surface
 	};
 }
 
-auto instance::get_layers() const -> std::vector<const char *>
+auto instance::get_layers() const -> const std::vector<const char *> &
 {
-	auto installed_layers = get_installed_layers();
-	auto available_layers = std::vector<std::string>{};
-	std::ranges::set_intersection(installed_layers, wanted_instance_layers, std::back_inserter(available_layers));
-	auto lyrs = convert_to_vec_char(available_layers);
-
-	return lyrs;
+	return layer_names;
 }
\ No newline at end of file
@@ -5,20 +5,32 @@ namespace vulkan_eg::vkw
 	class instance
 	{
 	public:
+		// Headless, no surface is created
+		instance(std::string_view name, std::string_view engine, uint32_t version);
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 		instance(std::string_view name, std::string_view engine, uint32_t version, HWND window_handle);
+#endif
 		~instance();
 
 		instance() = delete;
 
 		auto get() const -> std::tuple<const vk::Instance &, const vk::SurfaceKHR &>;
-		auto get_layers() const -> std::vector<const char *>;
+		// enabled on instance, so devices can enable them too
+		auto get_layers() const -> const std::vector<const char *> &;
 
 	private:
 		void create_instance(std::string_view name, std::string_view engine, uint32_t version);
 		void setup_debug_callback();
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 		void create_surface(HWND window_handle);
+#endif
 
 	private:
+		// wanted ones that are installed, enumerated once when instance is created
+		std::vector<std::string> enabled_layers;
+		std::vector<std::string> enabled_extensions;
+		std::vector<const char *> layer_names;     // point into enabled_layers
+
 		vk::SurfaceKHR vk_surface;
 		vk::DebugUtilsMessengerEXT debug_messenger;
 		vk::Instance vk_instance;
@@ -0,0 +1,127 @@
+#include "layout_cache.hpp"
+
+using namespace vulkan_eg::vkw;
+
+layout_cache::layout_cache(vk::Device &device)
+	: vk_device{ device }
+{ }
+
+layout_cache::~layout_cache()
+{
+	for (auto &&[key, bucket] : pipeline_layouts)
+	{
+		for (auto &&[signature, layout] : bucket)
+		{
+			vk_device.destroyPipelineLayout(layout.layout);
+		}
+	}
+
+	for (auto &&[key, bucket] : set_layouts)
+	{
+		for (auto &&[bindings, set_layout] : bucket)
+		{
+			vk_device.destroyDescriptorSetLayout(set_layout);
+		}
+	}
+}
+
+auto layout_cache::get_set_layout(std::span<const descriptor_binding> bindings) -> vk::DescriptorSetLayout
+{
+	auto key = hash(bindings);
+
+	auto lock = std::scoped_lock(layouts_mutex);
+	auto &bucket = set_layouts[key];
+	for (auto &&[cached_bindings, set_layout] : bucket)
+	{
+		if (std::ranges::equal(cached_bindings, bindings))
+		{
+			return set_layout;
+		}
+	}
+
+	auto set_layout = create_set_layout(bindings);
+	bucket.emplace_back(std::vector(bindings.begin(), bindings.end()), set_layout);
+	return set_layout;
+}
+
+auto layout_cache::get_pipeline_layout(const layout_signature &signature) -> pipeline_layout
+{
+	auto key = hash(signature);
+	{
+		auto lock = std::scoped_lock(layouts_mutex);
+		for (auto &&[cached_signature, layout] : pipeline_layouts[key])
+		{
+			if (cached_signature == signature)
+			{
+				return layout;
+			}
+		}
+	}
+
+	// one set layout per set number, unused numbers in between get an empty set
+	auto out = pipeline_layout{};
+	auto set_count = signature.bindings.empty() ? 0u : signature.bindings.back().set + 1;
+	if (not signature.external_sets.empty())
+	{
+		set_count = std::max(set_count, std::get<uint32_t>(signature.external_sets.back()) + 1);
+	}
+	for (auto set = 0u; set < set_count; ++set)
+	{
+		auto external = std::ranges::find(signature.external_sets, set, [](auto &&e) { return std::get<uint32_t>(e); });
+		if (external != signature.external_sets.end())
+		{
+			out.set_layouts.push_back(std::get<vk::DescriptorSetLayout>(*external));
+			continue;
+		}
+
+		auto first = std::ranges::find_if(signature.bindings, [&](auto &&b) { return b.set == set; });
+		auto last = std::find_if(first, signature.bindings.end(), [&](auto &&b) { return b.set != set; });
+		out.set_layouts.push_back(get_set_layout(std::span(first, last)));
+	}
+
+	auto layout_ci = vk::PipelineLayoutCreateInfo
+	{
+		.setLayoutCount = static_cast<uint32_t>(out.set_layouts.size()),
+		.pSetLayouts = out.set_layouts.data(),
+		.pushConstantRangeCount = static_cast<uint32_t>(signature.push_constants.size()),
+		.pPushConstantRanges = signature.push_constants.data()
+	};
+
+	auto lock = std::scoped_lock(layouts_mutex);
+	// another thread may have created it meanwhile
+	auto &bucket = pipeline_layouts[key];
+	for (auto &&[cached_signature, layout] : bucket)
+	{
+		if (cached_signature == signature)
+		{
+			return layout;
+		}
+	}
+
+	out.layout = vk_device.createPipelineLayout(layout_ci);
+	bucket.emplace_back(signature, out);
+	return out;
+}
+
+auto layout_cache::create_set_layout(std::span<const descriptor_binding> bindings) const -> vk::DescriptorSetLayout
+{
+	auto layout_bindings = std::vector<vk::DescriptorSetLayoutBinding>{};
+	for (auto &binding : bindings)
+	{
+		layout_bindings.push_back(
+		{
+			.binding = binding.binding,
+			.descriptorType = binding.type,
+			.descriptorCount = binding.count,
+			.stageFlags = binding.stages
+		});
+	}
+
+	auto layout_ci = vk::DescriptorSetLayoutCreateInfo
+	{
+		.bindingCount = static_cast<uint32_t>(layout_bindings.size()),
+		.pBindings = layout_bindings.data()
+	};
+
+	return vk_device.createDescriptorSetLayout(layout_ci);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "shader_reflection.hpp"
+
+namespace vulkan_eg::vkw
+{
+	struct pipeline_layout
+	{
+		vk::PipelineLayout layout;
+		std::vector<vk::DescriptorSetLayout> set_layouts; // indexed by set number
+	};
+
+	// Descriptor set and pipeline layouts keyed by reflected signature.
+	// Pipelines with the same signature share one layout, so bound descriptor sets stay valid across them.
+	// Layouts live as long as the cache, except a signature's external sets, which must outlive it.
+	class layout_cache
+	{
+	public:
+		explicit layout_cache(vk::Device &device);
+		~layout_cache();
+
+		layout_cache() = delete;
+		layout_cache(const layout_cache &) = delete;
+		auto operator=(const layout_cache &) -> layout_cache & = delete;
+
+		// bindings of a single set
+		[[nodiscard]] auto get_set_layout(std::span<const descriptor_binding> bindings) -> vk::DescriptorSetLayout;
+		[[nodiscard]] auto get_pipeline_layout(const layout_signature &signature) -> pipeline_layout;
+
+	private:
+		[[nodiscard]] auto create_set_layout(std::span<const descriptor_binding> bindings) const -> vk::DescriptorSetLayout;
+
+	private:
+		vk::Device vk_device;
+
+		std::mutex layouts_mutex;
+		std::unordered_map<size_t, std::vector<std::tuple<std::vector<descriptor_binding>, vk::DescriptorSetLayout>>> set_layouts;
+		std::unordered_map<size_t, std::vector<std::tuple<layout_signature, pipeline_layout>>> pipeline_layouts;
+	};
+}
@@ -0,0 +1,585 @@
+#include "memory_allocator.hpp"
+
+#include "devices.hpp"
+
+using namespace vulkan_eg::vkw;
+
+namespace
+{
+	// smallest buddy node, keeps free lists short for tiny allocations
+	constexpr auto min_node_size = vk::DeviceSize{ 256 };
+
+	auto align_up(vk::DeviceSize value, vk::DeviceSize alignment) -> vk::DeviceSize
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	auto order_of(vk::DeviceSize size) -> uint32_t
+	{
+		auto order = 0u;
+		while ((min_node_size << order) < size)
+		{
+			++order;
+		}
+		return order;
+	}
+
+	auto node_size(uint32_t order) -> vk::DeviceSize
+	{
+		return min_node_size << order;
+	}
+
+	auto pin_key(const allocation &alloc) -> std::tuple<VkDeviceMemory, vk::DeviceSize>
+	{
+		return { static_cast<VkDeviceMemory>(alloc.memory), alloc.offset };
+	}
+
+	auto is_host_visible(const vk::MemoryType &type) -> bool
+	{
+		return static_cast<bool>(type.propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible);
+	}
+}
+
+// Power of two sized block, split into power of two nodes.
+// Nodes are aligned to their own size, which covers any alignment up to it.
+struct memory_allocator::buddy_block
+{
+	vk::DeviceMemory memory;
+	std::byte *mapped{nullptr};
+	vk::DeviceSize size{};
+	std::vector<std::vector<vk::DeviceSize>> free_lists;                       // offsets, per order
+	std::unordered_map<vk::DeviceSize, std::tuple<uint32_t, vk::DeviceSize>> allocated; // offset -> order, requested size
+	vk::DeviceSize used{};
+
+	buddy_block(vk::DeviceMemory memory, std::byte *mapped, vk::DeviceSize size)
+		: memory{ memory }, mapped{ mapped }, size{ size }
+	{
+		free_lists.resize(order_of(size) + 1);
+		free_lists.back().push_back(0);
+	}
+
+	[[nodiscard]] auto allocate(vk::DeviceSize requested, uint32_t order) -> std::optional<vk::DeviceSize>
+	{
+		auto found = order;
+		while (found < free_lists.size() and free_lists[found].empty())
+		{
+			++found;
+		}
+		if (found >= free_lists.size())
+		{
+			return std::nullopt;
+		}
+
+		auto offset = free_lists[found].back();
+		free_lists[found].pop_back();
+
+		// split down, keeping lower half and freeing upper buddies
+		while (found > order)
+		{
+			--found;
+			free_lists[found].push_back(offset + node_size(found));
+		}
+
+		allocated.emplace(offset, std::tuple{ order, requested });
+		used += requested;
+		return offset;
+	}
+
+	void free(vk::DeviceSize offset)
+	{
+		auto it = allocated.find(offset);
+		if (it == allocated.end())
+		{
+			throw std::runtime_error("Freeing memory that was not allocated from this block");
+		}
+		auto [order, requested] = it->second;
+		allocated.erase(it);
+		used -= requested;
+
+		// merge with free buddies as far as possible
+		while (order + 1 < free_lists.size())
+		{
+			auto buddy = offset ^ node_size(order);
+			auto &list = free_lists[order];
+			auto found = std::ranges::find(list, buddy);
+			if (found == list.end())
+			{
+				break;
+			}
+			list.erase(found);
+			offset = std::min(offset, buddy);
+			++order;
+		}
+		free_lists[order].push_back(offset);
+	}
+
+	[[nodiscard]] auto largest_free() const -> vk::DeviceSize
+	{
+		for (auto order = free_lists.size(); order > 0; --order)
+		{
+			if (not free_lists[order - 1].empty())
+			{
+				return node_size(static_cast<uint32_t>(order - 1));
+			}
+		}
+		return 0;
+	}
+
+	[[nodiscard]] auto total_free() const -> vk::DeviceSize
+	{
+		auto total = vk::DeviceSize{ 0 };
+		for (auto &&[order, list] : ranges::views::enumerate(free_lists))
+		{
+			total += node_size(static_cast<uint32_t>(order)) * list.size();
+		}
+		return total;
+	}
+};
+
+struct memory_allocator::linear_block
+{
+	uint32_t memory_type{};
+	resource_kind kind{};
+	vk::DeviceMemory memory;
+	std::byte *mapped{nullptr};
+	vk::DeviceSize size{};
+	vk::DeviceSize offset{};
+};
+
+struct memory_allocator::pool
+{
+	uint32_t memory_type{};
+	std::vector<std::unique_ptr<buddy_block>> blocks; // null entries are released blocks, indices stay stable
+};
+
+memory_allocator::memory_allocator(devices *vkw_devices, uint32_t frame_count, vk::DeviceSize block_size)
+	: block_size{ std::bit_ceil(block_size) }
+{
+	vk_device = vkw_devices->get_device();
+	memory_properties = vkw_devices->get_physical_device().getMemoryProperties();
+
+	pools.resize(memory_properties.memoryTypeCount * 2);
+	for (auto &&[i, p] : ranges::views::enumerate(pools))
+	{
+		p.memory_type = static_cast<uint32_t>(i / 2);
+	}
+	frame_arenas.resize(frame_count);
+}
+
+memory_allocator::~memory_allocator()
+{
+	for (auto &p : pools)
+	{
+		for (auto &block : p.blocks)
+		{
+			if (block)
+			{
+				vk_device.freeMemory(block->memory);
+			}
+		}
+	}
+
+	for (auto &arena : frame_arenas)
+	{
+		for (auto &block : arena)
+		{
+			vk_device.freeMemory(block.memory);
+		}
+	}
+}
+
+auto memory_allocator::allocate(const vk::MemoryRequirements &requirements, memory_usage usage, resource_kind kind) -> allocation
+{
+	auto memory_type = find_memory_type(requirements.memoryTypeBits, usage);
+
+	auto lock = std::scoped_lock(allocator_mutex);
+
+	// too big to share a block, give it its own
+	if (requirements.size > block_size / 2)
+	{
+		auto [memory, mapped] = allocate_memory(memory_type, requirements.size);
+		dedicated_bytes += requirements.size;
+		++dedicated_count;
+		return allocation
+		{
+			.memory = memory,
+			.offset = 0,
+			.size = requirements.size,
+			.mapped = mapped,
+			.from = allocation::source::dedicated
+		};
+	}
+
+	auto pool_index = memory_type * 2 + static_cast<uint32_t>(kind);
+	if (auto alloc = allocate_pooled(pool_index, requirements.size, requirements.alignment))
+	{
+		return *alloc;
+	}
+
+	// every block is full, add one
+	auto [memory, mapped] = allocate_memory(memory_type, block_size);
+	auto &blocks = pools.at(pool_index).blocks;
+	auto empty_slot = std::ranges::find(blocks, nullptr);
+	auto new_block = std::make_unique<buddy_block>(memory, mapped, block_size);
+	if (empty_slot != blocks.end())
+	{
+		*empty_slot = std::move(new_block);
+	}
+	else
+	{
+		blocks.push_back(std::move(new_block));
+	}
+
+	return allocate_pooled(pool_index, requirements.size, requirements.alignment).value();
+}
+
+void memory_allocator::free(const allocation &alloc)
+{
+	auto lock = std::scoped_lock(allocator_mutex);
+	switch (alloc.from)
+	{
+	case allocation::source::pooled:
+		// defragment releases it once done moving it
+		if (auto pin = pinned.find(pin_key(alloc)); pin != pinned.end())
+		{
+			pin->second = true;
+			break;
+		}
+		free_pooled(alloc);
+		break;
+	case allocation::source::dedicated:
+		vk_device.freeMemory(alloc.memory);
+		dedicated_bytes -= alloc.size;
+		--dedicated_count;
+		break;
+	case allocation::source::linear:
+		// released with its frame
+		break;
+	}
+}
+
+auto memory_allocator::allocate_transient(const vk::MemoryRequirements &requirements, memory_usage usage, resource_kind kind) -> allocation
+{
+	auto memory_type = find_memory_type(requirements.memoryTypeBits, usage);
+
+	auto lock = std::scoped_lock(allocator_mutex);
+	auto &arena = frame_arenas.at(current_frame);
+
+	auto fits = [&](const linear_block &block)
+	{
+		return block.memory_type == memory_type and block.kind == kind
+		   and align_up(block.offset, requirements.alignment) + requirements.size <= block.size;
+	};
+
+	auto block = std::ranges::find_if(arena, fits);
+	if (block == arena.end())
+	{
+		auto size = std::max(block_size, std::bit_ceil(requirements.size));
+		auto [memory, mapped] = allocate_memory(memory_type, size);
+		arena.push_back(
+		{
+			.memory_type = memory_type,
+			.kind = kind,
+			.memory = memory,
+			.mapped = mapped,
+			.size = size
+		});
+		block = std::prev(arena.end());
+	}
+
+	auto offset = align_up(block->offset, requirements.alignment);
+	block->offset = offset + requirements.size;
+
+	return allocation
+	{
+		.memory = block->memory,
+		.offset = offset,
+		.size = requirements.size,
+		.mapped = block->mapped ? block->mapped + offset : nullptr,
+		.from = allocation::source::linear,
+		.block_index = static_cast<uint32_t>(std::distance(arena.begin(), block))
+	};
+}
+
+void memory_allocator::begin_frame(uint32_t frame_index)
+{
+	auto lock = std::scoped_lock(allocator_mutex);
+	current_frame = frame_index;
+	for (auto &block : frame_arenas.at(frame_index))
+	{
+		block.offset = 0;
+	}
+}
+
+auto memory_allocator::create_buffer(const vk::BufferCreateInfo &buffer_ci, memory_usage usage) -> std::tuple<vk::Buffer, allocation>
+{
+	auto buffer = vk_device.createBuffer(buffer_ci);
+	auto alloc = allocate(vk_device.getBufferMemoryRequirements(buffer), usage, resource_kind::linear);
+	vk_device.bindBufferMemory(buffer, alloc.memory, alloc.offset);
+	return { buffer, alloc };
+}
+
+void memory_allocator::destroy_buffer(vk::Buffer buffer, const allocation &alloc)
+{
+	vk_device.destroyBuffer(buffer);
+	free(alloc);
+}
+
+auto memory_allocator::create_image(const vk::ImageCreateInfo &image_ci, memory_usage usage) -> std::tuple<vk::Image, allocation>
+{
+	auto image = vk_device.createImage(image_ci);
+	auto kind = (image_ci.tiling == vk::ImageTiling::eOptimal) ? resource_kind::optimal : resource_kind::linear;
+	auto alloc = allocate(vk_device.getImageMemoryRequirements(image), usage, kind);
+	vk_device.bindImageMemory(image, alloc.memory, alloc.offset);
+	return { image, alloc };
+}
+
+void memory_allocator::destroy_image(vk::Image image, const allocation &alloc)
+{
+	vk_device.destroyImage(image);
+	free(alloc);
+}
+
+auto memory_allocator::defragment(const move_function &move, uint32_t max_moves) -> uint32_t
+{
+	auto moved = 0u;
+
+	for (auto pool_index = 0u; pool_index < pools.size() and moved < max_moves; ++pool_index)
+	{
+		// pick the least used block, its allocations are cheapest to move and it's most likely to empty
+		auto moves = std::vector<std::tuple<allocation, vk::DeviceSize>>{}; // allocation, its node size
+		{
+			auto lock = std::scoped_lock(allocator_mutex);
+			auto &blocks = pools[pool_index].blocks;
+			if (std::ranges::count_if(blocks, [](auto &&b) { return b != nullptr; }) < 2)
+			{
+				continue;
+			}
+
+			auto source = std::ranges::min_element(blocks, {}, [](auto &&b)
+			{
+				return b ? b->used : std::numeric_limits<vk::DeviceSize>::max();
+			});
+			auto block_index = static_cast<uint32_t>(std::distance(blocks.begin(), source));
+
+			for (auto &&[offset, info] : (*source)->allocated)
+			{
+				auto &&[order, requested] = info;
+				pinned.emplace(std::tuple{ static_cast<VkDeviceMemory>((*source)->memory), offset }, false);
+				moves.emplace_back(allocation
+				{
+					.memory = (*source)->memory,
+					.offset = offset,
+					.size = requested,
+					.mapped = (*source)->mapped ? (*source)->mapped + offset : nullptr,
+					.from = allocation::source::pooled,
+					.pool_index = pool_index,
+					.block_index = block_index
+				}, node_size(order));
+			}
+		}
+
+		// every snapshotted allocation is unpinned, moved or not
+		auto stopped = false;
+		for (auto &&[from, from_node_size] : moves)
+		{
+			auto to = std::optional<allocation>{};
+			{
+				auto lock = std::scoped_lock(allocator_mutex);
+				stopped = stopped or moved >= max_moves;
+				// owner freed it since the snapshot, nothing left to move
+				if (stopped or pinned.at(pin_key(from)))
+				{
+					unpin_locked(from);
+					continue;
+				}
+
+				// nodes are aligned to their size, so the same node size keeps the original alignment
+				to = allocate_pooled(pool_index, from.size, from_node_size, from.block_index);
+				if (not to)
+				{
+					stopped = true; // other blocks are full
+					unpin_locked(from);
+					continue;
+				}
+			}
+
+			// caller's code may allocate, so not called under lock.
+			// 'from' stays pinned meanwhile, so its range isn't handed out again while being read.
+			move(from, *to);
+			{
+				auto lock = std::scoped_lock(allocator_mutex);
+				pinned.erase(pin_key(from));
+				free_pooled(from);
+			}
+			++moved;
+		}
+	}
+
+	return moved;
+}
+
+auto memory_allocator::get_stats() const -> memory_stats
+{
+	auto lock = std::scoped_lock(allocator_mutex);
+
+	auto stats = memory_stats
+	{
+		.reserved = dedicated_bytes,
+		.used = dedicated_bytes,
+		.block_count = dedicated_count,
+		.allocation_count = dedicated_count
+	};
+
+	auto total_free = vk::DeviceSize{ 0 };
+	auto largest_free = vk::DeviceSize{ 0 };
+	for (auto &p : pools)
+	{
+		for (auto &block : p.blocks)
+		{
+			if (not block)
+			{
+				continue;
+			}
+			stats.reserved += block->size;
+			stats.used += block->used;
+			stats.block_count += 1;
+			stats.allocation_count += static_cast<uint32_t>(block->allocated.size());
+			total_free += block->total_free();
+			largest_free = std::max(largest_free, block->largest_free());
+		}
+	}
+
+	for (auto &arena : frame_arenas)
+	{
+		for (auto &block : arena)
+		{
+			stats.reserved += block.size;
+			stats.used += block.offset;
+			stats.block_count += 1;
+		}
+	}
+
+	stats.fragmentation = (total_free > 0)
+	                    ? 1.0 - static_cast<double>(largest_free) / static_cast<double>(total_free)
+	                    : 0.0;
+	return stats;
+}
+
+auto memory_allocator::find_memory_type(uint32_t type_bits, memory_usage usage) const -> uint32_t
+{
+	using mp = vk::MemoryPropertyFlagBits;
+
+	auto [required, preferred] = [&]() -> std::tuple<vk::MemoryPropertyFlags, vk::MemoryPropertyFlags>
+	{
+		switch (usage)
+		{
+		case memory_usage::gpu_only:
+			return { {}, mp::eDeviceLocal };
+		case memory_usage::upload:
+			return { mp::eHostVisible | mp::eHostCoherent, {} };
+		case memory_usage::readback:
+			// coherent, so reading it never needs an invalidate
+			return { mp::eHostVisible | mp::eHostCoherent, mp::eHostCached };
+		}
+		return {};
+	}();
+
+	auto best = std::optional<uint32_t>{};
+	for (auto i = 0u; i < memory_properties.memoryTypeCount; ++i)
+	{
+		auto flags = memory_properties.memoryTypes[i].propertyFlags;
+		if (not (type_bits & (1u << i)) or (flags & required) != required)
+		{
+			continue;
+		}
+		if ((flags & preferred) == preferred)
+		{
+			return i;
+		}
+		if (not best)
+		{
+			best = i;
+		}
+	}
+
+	if (not best)
+	{
+		throw std::runtime_error("Unable to find suitable memory type.");
+	}
+	return *best;
+}
+
+auto memory_allocator::allocate_memory(uint32_t memory_type, vk::DeviceSize size) -> std::tuple<vk::DeviceMemory, std::byte *>
+{
+	auto alloc_info = vk::MemoryAllocateInfo
+	{
+		.allocationSize = size,
+		.memoryTypeIndex = memory_type
+	};
+	auto memory = vk_device.allocateMemory(alloc_info);
+
+	// host visible blocks stay mapped for their whole life
+	auto mapped = static_cast<std::byte *>(nullptr);
+	if (is_host_visible(memory_properties.memoryTypes[memory_type]))
+	{
+		mapped = static_cast<std::byte *>(vk_device.mapMemory(memory, 0, VK_WHOLE_SIZE));
+	}
+
+	return { memory, mapped };
+}
+
+auto memory_allocator::allocate_pooled(uint32_t pool_index, vk::DeviceSize size, vk::DeviceSize alignment,
+                                       std::optional<uint32_t> skip_block) -> std::optional<allocation>
+{
+	auto order = order_of(std::max(size, alignment));
+	auto &blocks = pools.at(pool_index).blocks;
+
+	for (auto &&[block_index, block] : ranges::views::enumerate(blocks))
+	{
+		if (not block or skip_block == block_index)
+		{
+			continue;
+		}
+
+		if (auto offset = block->allocate(size, order))
+		{
+			return allocation
+			{
+				.memory = block->memory,
+				.offset = *offset,
+				.size = size,
+				.mapped = block->mapped ? block->mapped + *offset : nullptr,
+				.from = allocation::source::pooled,
+				.pool_index = pool_index,
+				.block_index = static_cast<uint32_t>(block_index)
+			};
+		}
+	}
+
+	return std::nullopt;
+}
+
+void memory_allocator::unpin_locked(const allocation &alloc)
+{
+	auto pin = pinned.extract(pin_key(alloc));
+	if (pin and pin.mapped())
+	{
+		free_pooled(alloc);
+	}
+}
+
+void memory_allocator::free_pooled(const allocation &alloc)
+{
+	auto &blocks = pools.at(alloc.pool_index).blocks;
+	auto &block = blocks.at(alloc.block_index);
+	block->free(alloc.offset);
+
+	// give empty blocks back to driver, keeping one around so alloc/free cycles don't thrash
+	auto live_blocks = std::ranges::count_if(blocks, [](auto &&b) { return b != nullptr; });
+	if (block->allocated.empty() and live_blocks > 1)
+	{
+		vk_device.freeMemory(block->memory);
+		block.reset();
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	class devices;
+
+	enum class memory_usage
+	{
+		gpu_only,    // device local
+		upload,      // host visible and coherent, persistently mapped
+		readback,    // host visible and coherent, cached if possible, persistently mapped
+	};
+
+	// Buffers and linear images never share a block with optimal images,
+	// so bufferImageGranularity never has to be padded for within a block.
+	enum class resource_kind
+	{
+		linear,
+		optimal,
+	};
+
+	struct allocation
+	{
+		vk::DeviceMemory memory;
+		vk::DeviceSize offset{};
+		vk::DeviceSize size{};
+		std::byte *mapped{nullptr};    // non-null for host visible memory
+
+		// where it came from, used by free()
+		enum class source : uint8_t { pooled, linear, dedicated } from{source::pooled};
+		uint32_t pool_index{};
+		uint32_t block_index{};
+	};
+
+	struct memory_stats
+	{
+		vk::DeviceSize reserved{};     // bytes allocated from driver
+		vk::DeviceSize used{};         // bytes handed out
+		uint32_t block_count{};        // driver allocations, including dedicated ones
+		uint32_t allocation_count{};   // live pooled and dedicated allocations
+		double fragmentation{};        // 1 - largest free range / total free, over pooled blocks
+	};
+
+	// Sub-allocates large device memory blocks per memory type, so resources don't each need a vkAllocateMemory.
+	// Long lived resources come from buddy allocated pools, freed individually.
+	// Transient resources come from per frame linear arenas, released all at once by begin_frame.
+	class memory_allocator
+	{
+	public:
+		// moves 'from' to 'to': caller recreates its resource on 'to', copies contents over,
+		// and must no longer be using 'from' on GPU. 'from' is freed afterwards.
+		using move_function = std::function<void(const allocation &from, const allocation &to)>;
+
+		memory_allocator(devices *vkw_devices, uint32_t frame_count, vk::DeviceSize block_size = 64ull << 20);
+		~memory_allocator();
+
+		memory_allocator() = delete;
+		memory_allocator(const memory_allocator &) = delete;
+		auto operator=(const memory_allocator &) -> memory_allocator & = delete;
+
+		[[nodiscard]] auto allocate(const vk::MemoryRequirements &requirements, memory_usage usage, resource_kind kind) -> allocation;
+		void free(const allocation &alloc);
+
+		// Valid until begin_frame is called again with the same frame index
+		[[nodiscard]] auto allocate_transient(const vk::MemoryRequirements &requirements, memory_usage usage, resource_kind kind) -> allocation;
+		// Call once frame_index's previous use has completed on GPU, recycles its transient memory
+		void begin_frame(uint32_t frame_index);
+
+		[[nodiscard]] auto create_buffer(const vk::BufferCreateInfo &buffer_ci, memory_usage usage) -> std::tuple<vk::Buffer, allocation>;
+		void destroy_buffer(vk::Buffer buffer, const allocation &alloc);
+		[[nodiscard]] auto create_image(const vk::ImageCreateInfo &image_ci, memory_usage usage) -> std::tuple<vk::Image, allocation>;
+		void destroy_image(vk::Image image, const allocation &alloc);
+
+		// Empties the least used block of each pool into the others, up to max_moves allocations.
+		// Returns number of allocations moved.
+		// Allocations being moved stay reserved until defragment is done with them, so an owner freeing one
+		// meanwhile releases it exactly once: right away if not yet moved (it's skipped), otherwise after its move.
+		auto defragment(const move_function &move, uint32_t max_moves = UINT32_MAX) -> uint32_t;
+
+		[[nodiscard]] auto get_stats() const -> memory_stats;
+
+	private:
+		struct buddy_block;
+		struct linear_block;
+		struct pool;
+
+		[[nodiscard]] auto find_memory_type(uint32_t type_bits, memory_usage usage) const -> uint32_t;
+		[[nodiscard]] auto allocate_memory(uint32_t memory_type, vk::DeviceSize size) -> std::tuple<vk::DeviceMemory, std::byte *>;
+		[[nodiscard]] auto allocate_pooled(uint32_t pool_index, vk::DeviceSize size, vk::DeviceSize alignment,
+		                                   std::optional<uint32_t> skip_block = std::nullopt) -> std::optional<allocation>;
+		void free_pooled(const allocation &alloc);
+		// drops defragment's pin, freeing allocation if its owner freed it while pinned
+		void unpin_locked(const allocation &alloc);
+
+	private:
+		vk::Device vk_device;
+		vk::PhysicalDeviceMemoryProperties memory_properties;
+		vk::DeviceSize block_size;
+
+		mutable std::mutex allocator_mutex;
+		std::vector<pool> pools;                              // [memory type * 2 + resource kind]
+		std::map<std::tuple<VkDeviceMemory, vk::DeviceSize>, bool> pinned; // memory, offset -> owner freed it, while defragment moves it
+		std::vector<std::vector<linear_block>> frame_arenas;  // [frame index]
+		uint32_t current_frame{0};
+
+		vk::DeviceSize dedicated_bytes{};
+		uint32_t dedicated_count{};
+	};
+}
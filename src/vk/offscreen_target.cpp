@@ -0,0 +1,219 @@
+#include "offscreen_target.hpp"
+
+#include "devices.hpp"
+#include "startup_trace.hpp"
+
+using namespace vulkan_eg::vkw;
+
+offscreen_target::offscreen_target(devices *vkw_devices, memory_allocator *vkw_allocator, vk::Extent2D extent, uint32_t image_count, 
+                                   vk::Format format, bool with_render_pass)
+	: vkw_allocator{ vkw_allocator }, vk_format{ format }, vk_extent{ extent }
+{
+	auto scope = trace_scope("offscreen_target::offscreen_target");
+	vk_device = vkw_devices->get_device();
+	create_images(image_count);
+	if (with_render_pass)
+	{
+		create_renderpass();
+		create_frame_buffers();
+	}
+}
+
+offscreen_target::~offscreen_target()
+{
+	destroy_frame_buffers();
+	destroy_images();
+	vk_device.destroyRenderPass(vk_render_pass);
+}
+
+void offscreen_target::create_images(uint32_t image_count)
+{
+	vk_images.resize(image_count);
+	vk_image_memory.resize(image_count);
+	vk_image_views.resize(image_count);
+
+	for (auto &&[image, memory, image_view] : ranges::views::zip(vk_images, vk_image_memory, vk_image_views))
+	{
+		auto image_ci = vk::ImageCreateInfo
+		{
+			.imageType = vk::ImageType::e2D,
+			.format = vk_format,
+			.extent = {
+				.width = vk_extent.width,
+				.height = vk_extent.height,
+				.depth = 1
+			},
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = vk::SampleCountFlagBits::e1,
+			.tiling = vk::ImageTiling::eOptimal,
+			.usage = vk::ImageUsageFlagBits::eColorAttachment
+			       | vk::ImageUsageFlagBits::eTransferSrc,
+			.sharingMode = vk::SharingMode::eExclusive,
+			.initialLayout = vk::ImageLayout::eUndefined
+		};
+		std::tie(image, memory) = vkw_allocator->create_image(image_ci, memory_usage::gpu_only);
+
+		auto view_ci = vk::ImageViewCreateInfo
+		{
+			.image = image,
+			.viewType = vk::ImageViewType::e2D,
+			.format = vk_format,
+			.components = {
+				.r = vk::ComponentSwizzle::eIdentity,
+				.g = vk::ComponentSwizzle::eIdentity,
+				.b = vk::ComponentSwizzle::eIdentity,
+				.a = vk::ComponentSwizzle::eIdentity,
+			},
+			.subresourceRange = {
+				.aspectMask = vk::ImageAspectFlagBits::eColor,
+				.baseMipLevel = 0,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1
+			}
+		};
+		image_view = vk_device.createImageView(view_ci);
+	}
+}
+
+void offscreen_target::create_renderpass()
+{
+	// Same as swap_chain's render pass, except images end up ready to be read back
+	auto color_attachment = vk::AttachmentDescription
+	{
+		.format = vk_format,
+		.samples = vk::SampleCountFlagBits::e1,
+		.loadOp = vk::AttachmentLoadOp::eClear,
+		.storeOp = vk::AttachmentStoreOp::eStore,
+		.stencilLoadOp = vk::AttachmentLoadOp::eDontCare,
+		.stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
+		.initialLayout = vk::ImageLayout::eUndefined,
+		.finalLayout = final_layout()
+	};
+
+	auto color_attachment_ref = vk::AttachmentReference
+	{
+		.attachment = 0,
+		.layout = vk::ImageLayout::eColorAttachmentOptimal
+	};
+
+	auto sub_pass = vk::SubpassDescription
+	{
+		.pipelineBindPoint = vk::PipelineBindPoint::eGraphics,
+		.colorAttachmentCount = 1,
+		.pColorAttachments = &color_attachment_ref
+	};
+
+	auto dependency = vk::SubpassDependency
+	{
+		.srcSubpass = VK_SUBPASS_EXTERNAL,
+		.dstSubpass = 0,
+		.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+		.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+		.srcAccessMask = vk::AccessFlagBits::eNone,
+		.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite
+	};
+
+	auto create_info = vk::RenderPassCreateInfo
+	{
+		.attachmentCount = 1,
+		.pAttachments = &color_attachment,
+		.subpassCount = 1,
+		.pSubpasses = &sub_pass,
+		.dependencyCount = 1,
+		.pDependencies = &dependency
+	};
+
+	vk_render_pass = vk_device.createRenderPass(create_info);
+}
+
+void offscreen_target::create_frame_buffers()
+{
+	vk_frame_buffers.resize(vk_image_views.size());
+
+	for(auto &&[image_view, frame_buffer] : ranges::views::zip(vk_image_views, vk_frame_buffers))
+	{
+		auto attachments = std::vector<vk::ImageView>{image_view};
+		auto create_info = vk::FramebufferCreateInfo
+		{
+			.renderPass = vk_render_pass,
+			.attachmentCount = static_cast<uint32_t>(attachments.size()),
+			.pAttachments = attachments.data(),
+			.width = vk_extent.width,
+			.height = vk_extent.height,
+			.layers = 1
+		};
+
+		frame_buffer = vk_device.createFramebuffer(create_info);
+	}
+}
+
+void offscreen_target::destroy_images()
+{
+	for (auto &&[image, memory, image_view] : ranges::views::zip(vk_images, vk_image_memory, vk_image_views))
+	{
+		if (image_view)
+		{
+			vk_device.destroyImageView(image_view);
+			image_view = nullptr;
+		}
+		if (image)
+		{
+			vkw_allocator->destroy_image(image, memory);
+			image = nullptr;
+		}
+	}
+}
+
+void offscreen_target::destroy_frame_buffers()
+{
+	for (auto &fb : vk_frame_buffers)
+	{
+		if (fb)
+		{
+			vk_device.destroyFramebuffer(fb);
+			fb = nullptr;
+		}
+	}
+}
+
+auto offscreen_target::get_render_pass() -> vk::RenderPass &
+{
+	return vk_render_pass;
+}
+
+auto offscreen_target::get_extent() -> vk::Extent2D
+{
+	return vk_extent;
+}
+
+auto offscreen_target::get_format() const -> vk::Format
+{
+	return vk_format;
+}
+
+auto offscreen_target::frame_buffer(uint32_t index) -> vk::Framebuffer &
+{
+	return vk_frame_buffers.at(index);
+}
+
+auto offscreen_target::image_count() const -> uint32_t
+{
+	return static_cast<uint32_t>(vk_images.size());
+}
+
+auto offscreen_target::image(uint32_t index) -> vk::Image &
+{
+	return vk_images.at(index);
+}
+
+auto offscreen_target::image_view(uint32_t index) -> vk::ImageView &
+{
+	return vk_image_views.at(index);
+}
+
+auto offscreen_target::final_layout() const -> vk::ImageLayout
+{
+	return vk::ImageLayout::eTransferSrcOptimal;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "render_target.hpp"
+#include "memory_allocator.hpp"
+
+namespace vulkan_eg::vkw
+{
+	class devices;
+
+	// Owns its own color images, so renderer can run without a window or display.
+	class offscreen_target : public render_target
+	{
+	public:
+		// without render pass, target has no render pass or frame buffers and is drawn into with dynamic rendering
+		offscreen_target(devices *vkw_devices, memory_allocator *vkw_allocator, vk::Extent2D extent, uint32_t image_count, 
+		                 vk::Format format = vk::Format::eR8G8B8A8Unorm, bool with_render_pass = true);
+		~offscreen_target() override;
+
+		offscreen_target() = delete;
+
+		[[nodiscard]] auto get_render_pass() -> vk::RenderPass & override;
+		[[nodiscard]] auto get_extent() -> vk::Extent2D override;
+		[[nodiscard]] auto get_format() const -> vk::Format override;
+		[[nodiscard]] auto frame_buffer(uint32_t index) -> vk::Framebuffer & override;
+		[[nodiscard]] auto image_count() const -> uint32_t override;
+		[[nodiscard]] auto image(uint32_t index) -> vk::Image & override;
+		[[nodiscard]] auto image_view(uint32_t index) -> vk::ImageView & override;
+		[[nodiscard]] auto final_layout() const -> vk::ImageLayout override;
+
+	private:
+		void create_images(uint32_t image_count);
+		void create_renderpass();
+		void create_frame_buffers();
+
+		void destroy_images();
+		void destroy_frame_buffers();
+
+	private:
+		vk::Device vk_device;
+		memory_allocator *vkw_allocator;
+		vk::Format vk_format;
+		vk::Extent2D vk_extent;
+		vk::RenderPass vk_render_pass;
+		std::vector<vk::Image> vk_images;
+		std::vector<allocation> vk_image_memory;
+		std::vector<vk::ImageView> vk_image_views;
+		std::vector<vk::Framebuffer> vk_frame_buffers;
+	};
+}
@@ -1,25 +1,597 @@
 #include "pipeline.hpp"
 
-using namespace Vulkan_eg::vkw;
+#include "pipeline_cache.hpp"
+#include "hash.hpp"
+#include "thread_pool.hpp"
+#include "startup_trace.hpp"
+
+using namespace vulkan_eg::vkw;
 
 namespace
 {
+	// formats reflection produces are all 32-bit components, packed ones come from vertex_formats
+	auto format_size(vk::Format format) -> uint32_t
+	{
+		switch (format)
+		{
+		case vk::Format::eR32Sfloat:
+		case vk::Format::eR32Sint:
+		case vk::Format::eR32Uint:
+		case vk::Format::eR8G8B8A8Unorm:
+		case vk::Format::eR8G8B8A8Snorm:
+		case vk::Format::eR16G16Sfloat:
+			return 4;
+		case vk::Format::eR16G16B16A16Sfloat:
+		case vk::Format::eR32G32Sfloat:
+		case vk::Format::eR32G32Sint:
+		case vk::Format::eR32G32Uint:
+			return 8;
+		case vk::Format::eR32G32B32Sfloat:
+		case vk::Format::eR32G32B32Sint:
+		case vk::Format::eR32G32B32Uint:
+			return 12;
+		case vk::Format::eR32G32B32A32Sfloat:
+		case vk::Format::eR32G32B32A32Sint:
+		case vk::Format::eR32G32B32A32Uint:
+			return 16;
+		default:
+			throw std::runtime_error("Unsupported vertex input format");
+		}
+	}
+
+	auto create_shader_module(vk::Device &device, const shader_code &code) -> vk::ShaderModule
+	{
+		// straight from embedded or mapped memory
+		auto createInfo = vk::ShaderModuleCreateInfo
+		{
+			.codeSize = code.size_bytes(),
+			.pCode = code.words().data()
+		};
+
+		return device.createShaderModule(createInfo);
+	}
+
+	// SPIR-V doesn't say whether a buffer is bound with a dynamic offset, or whether a set is shared
+	// with resources the shader doesn't declare, descriptor does
+	auto make_signature(std::span<const shader_reflection> reflections, 
+	                    const std::vector<std::tuple<uint32_t, uint32_t>> &dynamic_buffers,
+	                    const std::vector<std::tuple<uint32_t, vk::DescriptorSetLayout>> &external_sets) -> layout_signature
+	{
+		auto signature = merge(reflections);
+
+		signature.external_sets = external_sets;
+		std::ranges::sort(signature.external_sets, {}, [](auto &&e) { return std::get<uint32_t>(e); });
+		std::erase_if(signature.bindings, [&](auto &&binding)
+		{
+			return std::ranges::find(external_sets, binding.set, [](auto &&e) { return std::get<uint32_t>(e); }) != external_sets.end();
+		});
+		for (auto &binding : signature.bindings)
+		{
+			auto is_dynamic = std::ranges::find(dynamic_buffers, std::tuple{ binding.set, binding.binding }) != dynamic_buffers.end();
+			if (not is_dynamic)
+			{
+				continue;
+			}
+
+			if (binding.type == vk::DescriptorType::eUniformBuffer)
+			{
+				binding.type = vk::DescriptorType::eUniformBufferDynamic;
+			}
+			else if (binding.type == vk::DescriptorType::eStorageBuffer)
+			{
+				binding.type = vk::DescriptorType::eStorageBufferDynamic;
+			}
+		}
+		return signature;
+	}
+
+	// Constants a stage declares, packed as 32-bit values. info points into entries and data, so it must not move.
+	struct stage_specialization
+	{
+		std::vector<vk::SpecializationMapEntry> entries;
+		std::vector<uint32_t> data;
+		vk::SpecializationInfo info;
+
+		stage_specialization(const shader_reflection &reflection, const std::vector<std::tuple<uint32_t, uint32_t>> &values)
+		{
+			for (auto &constant : reflection.specialization_constants)
+			{
+				auto value = std::ranges::find_if(values, [&](auto &&c)
+				{
+					return std::get<0>(c) == constant.constant_id;
+				});
+				if (value == values.end())
+				{
+					continue;
+				}
 
+				entries.push_back(
+				{
+					.constantID = constant.constant_id,
+					.offset = static_cast<uint32_t>(data.size() * sizeof(uint32_t)),
+					.size = sizeof(uint32_t)
+				});
+				data.push_back(std::get<1>(*value));
+			}
+
+			info = vk::SpecializationInfo
+			{
+				.mapEntryCount = static_cast<uint32_t>(entries.size()),
+				.pMapEntries = entries.data(),
+				.dataSize = data.size() * sizeof(uint32_t),
+				.pData = data.data()
+			};
+		}
+
+		stage_specialization(const stage_specialization &) = delete;
+
+		[[nodiscard]] auto get() const -> const vk::SpecializationInfo *
+		{
+			return entries.empty() ? nullptr : &info;
+		}
+	};
 }
 
-pipeline::pipeline(vk::Device &device, const pipeline_descriptor &desc) 
+auto vulkan_eg::vkw::hash(const pipeline_descriptor &desc) -> size_t
+{
+	auto seed = size_t{ 0 };
+
+	for (auto &&[stage, code] : desc.shaders)
+	{
+		hash_combine(seed, static_cast<uint32_t>(stage));
+		hash_combine(seed, hash_words(code.words()));
+	}
+	hash_combine(seed, static_cast<uint32_t>(desc.topology));
+	hash_combine(seed, static_cast<uint32_t>(desc.polygon_mode));
+	hash_combine(seed, static_cast<uint32_t>(desc.cull_mode));
+	hash_combine(seed, static_cast<uint32_t>(desc.front_face));
+	hash_combine(seed, desc.blend_enable);
+	for (auto format : desc.color_formats)
+	{
+		hash_combine(seed, static_cast<uint32_t>(format));
+	}
+	hash_combine(seed, static_cast<VkRenderPass>(desc.render_pass));
+	for (auto &&[constant_id, value] : desc.specialization_constants)
+	{
+		hash_combine(seed, constant_id);
+		hash_combine(seed, value);
+	}
+	for (auto &&[set, binding] : desc.dynamic_buffers)
+	{
+		hash_combine(seed, set);
+		hash_combine(seed, binding);
+	}
+	for (auto &stream : desc.vertex_streams)
+	{
+		for (auto location : stream.locations)
+		{
+			hash_combine(seed, location);
+		}
+		hash_combine(seed, static_cast<uint32_t>(stream.input_rate));
+	}
+	for (auto &&[location, format] : desc.vertex_formats)
+	{
+		hash_combine(seed, location);
+		hash_combine(seed, static_cast<uint32_t>(format));
+	}
+	for (auto &&[set, set_layout] : desc.external_sets)
+	{
+		hash_combine(seed, set);
+		hash_combine(seed, static_cast<VkDescriptorSetLayout>(set_layout));
+	}
+
+	return seed;
+}
+
+pipeline::pipeline(vk::Device &device, vk::PipelineCache cache, layout_cache &layouts, const pipeline_descriptor &desc)
 	: vk_device{ device }
 {
-	create_pipeline(desc);
+	auto start = std::chrono::steady_clock::now();
+	create_pipeline(cache, layouts, desc);
+	creation_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 }
 
 pipeline::~pipeline()
 {
 	vk_device.destroyPipeline(vk_pipeline);
-	vk_device.destroyPipelineLayout(vk_pipeline_layout);
 }
 
-void pipeline::create_pipeline(const pipeline_descriptor &desc)
+auto pipeline::get() const -> vk::Pipeline
+{
+	return vk_pipeline;
+}
+
+auto pipeline::get_layout() const -> vk::PipelineLayout
+{
+	return vk_pipeline_layout.layout;
+}
+
+auto pipeline::get_set_layouts() const -> const std::vector<vk::DescriptorSetLayout> &
+{
+	return vk_pipeline_layout.set_layouts;
+}
+
+auto pipeline::get_creation_time() const -> double
+{
+	return creation_time;
+}
+
+void pipeline::create_pipeline(vk::PipelineCache cache, layout_cache &layouts, const pipeline_descriptor &desc)
+{
+	auto stage_reflections = std::vector<shader_reflection>{};
+	for (auto &&[stage, code] : desc.shaders)
+	{
+		stage_reflections.push_back(reflect(stage, code.words()));
+	}
+
+	vk_pipeline_layout = layouts.get_pipeline_layout(make_signature(stage_reflections, desc.dynamic_buffers, desc.external_sets));
+
+	// create infos point into these, so they're all built before any are used
+	auto specializations = std::deque<stage_specialization>{};
+	auto shader_modules = std::vector<vk::ShaderModule>{};
+	auto shader_stages = std::vector<vk::PipelineShaderStageCreateInfo>{};
+	for (auto &&[i, shader] : ranges::views::enumerate(desc.shaders))
+	{
+		auto &&[stage, code] = shader;
+		auto &specialization = specializations.emplace_back(stage_reflections[i], desc.specialization_constants);
+
+		auto module = shader_modules.emplace_back(create_shader_module(vk_device, code));
+		shader_stages.push_back(vk::PipelineShaderStageCreateInfo
+		{
+			.stage = stage,
+			.module = module,
+			.pName = "main",
+			.pSpecializationInfo = specialization.get()
+		});
+	}
+
+	auto vertex_inputs = std::vector<vertex_input>{};
+	for (auto &reflection : stage_reflections)
+	{
+		vertex_inputs.insert(vertex_inputs.end(), reflection.vertex_inputs.begin(), reflection.vertex_inputs.end());
+	}
+	for (auto &input : vertex_inputs)
+	{
+		auto format = std::ranges::find(desc.vertex_formats, input.location, [](auto &&f) { return std::get<0>(f); });
+		if (format != desc.vertex_formats.end())
+		{
+			input.format = std::get<vk::Format>(*format);
+		}
+	}
+
+	// Without streams, vertex inputs are interleaved in one per-vertex buffer, in location order
+	auto streams = desc.vertex_streams;
+	if (streams.empty() and not vertex_inputs.empty())
+	{
+		auto &stream = streams.emplace_back();
+		for (auto &input : vertex_inputs)
+		{
+			stream.locations.push_back(input.location);
+		}
+	}
+
+	auto vertex_attributes = std::vector<vk::VertexInputAttributeDescription>{};
+	auto vertex_bindings = std::vector<vk::VertexInputBindingDescription>{};
+	for (auto &&[binding, stream] : ranges::views::enumerate(streams))
+	{
+		auto stride = 0u;
+		for (auto location : stream.locations)
+		{
+			auto input = std::ranges::find(vertex_inputs, location, &vertex_input::location);
+			if (input == vertex_inputs.end())
+			{
+				throw std::runtime_error(std::format("Vertex stream {} lists location {}, vertex shader has no such input", binding, location));
+			}
+
+			vertex_attributes.push_back(
+			{
+				.location = location,
+				.binding = static_cast<uint32_t>(binding),
+				.format = input->format,
+				.offset = stride
+			});
+			stride += format_size(input->format);
+		}
+
+		vertex_bindings.push_back(
+		{
+			.binding = static_cast<uint32_t>(binding),
+			.stride = stride,
+			.inputRate = stream.input_rate
+		});
+	}
+
+	if (vertex_attributes.size() != vertex_inputs.size())
+	{
+		throw std::runtime_error("Vertex streams don't cover every vertex shader input");
+	}
+
+	auto vert_input_ci = vk::PipelineVertexInputStateCreateInfo
+	{
+		.vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_bindings.size()),
+		.pVertexBindingDescriptions = vertex_bindings.data(),
+		.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_attributes.size()),
+		.pVertexAttributeDescriptions = vertex_attributes.data()
+	};
+
+	auto inpt_asmbly_ci = vk::PipelineInputAssemblyStateCreateInfo
+	{
+		.topology = desc.topology,
+		.primitiveRestartEnable = false
+	};
+
+	auto viewport_ci = vk::PipelineViewportStateCreateInfo
+	{
+		.viewportCount = 1,
+		.scissorCount = 1
+	};
+
+	auto rasterizer_ci = vk::PipelineRasterizationStateCreateInfo
+	{
+		.depthClampEnable = false,
+		.rasterizerDiscardEnable = false,
+		.polygonMode = desc.polygon_mode,
+		.cullMode = desc.cull_mode,
+		.frontFace = desc.front_face,
+		.depthBiasEnable = false,
+		.lineWidth = 1.0f
+	};
+
+	auto multisample_ci = vk::PipelineMultisampleStateCreateInfo
+	{
+		.rasterizationSamples = vk::SampleCountFlagBits::e1,
+		.sampleShadingEnable = false
+	};
+
+	auto clr_blend_attch_st = vk::PipelineColorBlendAttachmentState
+	{
+		.blendEnable = desc.blend_enable,
+		.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+		.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+		.colorBlendOp = vk::BlendOp::eAdd,
+		.srcAlphaBlendFactor = vk::BlendFactor::eOne,
+		.dstAlphaBlendFactor = vk::BlendFactor::eZero,
+		.alphaBlendOp = vk::BlendOp::eAdd,
+		.colorWriteMask = vk::ColorComponentFlagBits::eR
+		                | vk::ColorComponentFlagBits::eG
+		                | vk::ColorComponentFlagBits::eB
+		                | vk::ColorComponentFlagBits::eA
+	};
+	auto clr_blend_attachments = std::vector(desc.color_formats.size(), clr_blend_attch_st);
+
+	auto color_blend_ci = vk::PipelineColorBlendStateCreateInfo
+	{
+		.logicOpEnable = false,
+		.logicOp = vk::LogicOp::eCopy,
+		.attachmentCount = static_cast<uint32_t>(clr_blend_attachments.size()),
+		.pAttachments = clr_blend_attachments.data(),
+		.blendConstants = std::array{0.0f, 0.0f, 0.0f, 0.0f}
+	};
+
+	auto dynamic_states_array = std::vector
+	{
+		vk::DynamicState::eViewport,
+		vk::DynamicState::eScissor,
+	};
+
+	auto dynamic_state = vk::PipelineDynamicStateCreateInfo
+	{
+		.dynamicStateCount = static_cast<uint32_t>(dynamic_states_array.size()),
+		.pDynamicStates = dynamic_states_array.data()
+	};
+
+	// without a render pass, attachment formats come from here and pipeline is used with beginRendering
+	auto rendering_ci = vk::PipelineRenderingCreateInfo
+	{
+		.colorAttachmentCount = static_cast<uint32_t>(desc.color_formats.size()),
+		.pColorAttachmentFormats = desc.color_formats.data()
+	};
+
+	auto gfx_pipeline_ci = vk::GraphicsPipelineCreateInfo
+	{
+		.pNext = desc.render_pass ? nullptr : &rendering_ci,
+		.stageCount = static_cast<uint32_t>(shader_stages.size()),
+		.pStages = shader_stages.data(),
+		.pVertexInputState = &vert_input_ci,
+		.pInputAssemblyState = &inpt_asmbly_ci,
+		.pViewportState = &viewport_ci,
+		.pRasterizationState = &rasterizer_ci,
+		.pMultisampleState = &multisample_ci,
+		.pColorBlendState = &color_blend_ci,
+		.pDynamicState = &dynamic_state,
+		.layout = vk_pipeline_layout.layout,
+		.renderPass = desc.render_pass,
+		.subpass = 0
+	};
+
+	auto result = vk::Result{};
+	std::tie(result, vk_pipeline) = vk_device.createGraphicsPipeline(cache, gfx_pipeline_ci);
+
+	for (auto shader_module : shader_modules)
+	{
+		vk_device.destroyShaderModule(shader_module);
+	}
+
+	if (result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Unable to create graphics pipeline");
+	}
+}
+
+compute_pipeline::compute_pipeline(vk::Device &device, vk::PipelineCache cache, layout_cache &layouts, const compute_pipeline_descriptor &desc)
+	: vk_device{ device }
 {
+	auto start = std::chrono::steady_clock::now();
+
+	auto reflection = std::array{ reflect(vk::ShaderStageFlagBits::eCompute, desc.shader.words()) };
+	vk_pipeline_layout = layouts.get_pipeline_layout(make_signature(reflection, desc.dynamic_buffers, desc.external_sets));
+
+	auto specialization = stage_specialization(reflection.front(), desc.specialization_constants);
+	auto module = create_shader_module(vk_device, desc.shader);
+
+	auto compute_pipeline_ci = vk::ComputePipelineCreateInfo
+	{
+		.stage = {
+			.stage = vk::ShaderStageFlagBits::eCompute,
+			.module = module,
+			.pName = "main",
+			.pSpecializationInfo = specialization.get()
+		},
+		.layout = vk_pipeline_layout.layout
+	};
 
-}
\ No newline at end of file
+	auto result = vk::Result{};
+	std::tie(result, vk_pipeline) = vk_device.createComputePipeline(cache, compute_pipeline_ci);
+
+	vk_device.destroyShaderModule(module);
+
+	if (result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Unable to create compute pipeline");
+	}
+
+	creation_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+compute_pipeline::~compute_pipeline()
+{
+	vk_device.destroyPipeline(vk_pipeline);
+}
+
+auto compute_pipeline::get() const -> vk::Pipeline
+{
+	return vk_pipeline;
+}
+
+auto compute_pipeline::get_layout() const -> vk::PipelineLayout
+{
+	return vk_pipeline_layout.layout;
+}
+
+auto compute_pipeline::get_set_layouts() const -> const std::vector<vk::DescriptorSetLayout> &
+{
+	return vk_pipeline_layout.set_layouts;
+}
+
+auto compute_pipeline::get_creation_time() const -> double
+{
+	return creation_time;
+}
+
+pipeline_handle::pipeline_handle(std::shared_future<std::shared_ptr<pipeline>> compiled)
+	: compiled{ std::move(compiled) }
+{ }
+
+auto pipeline_handle::is_ready() const -> bool
+{
+	return compiled.valid() 
+	   and compiled.wait_for(std::chrono::seconds::zero()) == std::future_status::ready;
+}
+
+auto pipeline_handle::get() const -> pipeline *
+{
+	if (not is_ready())
+	{
+		return nullptr;
+	}
+	return compiled.get().get();
+}
+
+auto pipeline_handle::wait() const -> std::shared_ptr<pipeline>
+{
+	return compiled.get();
+}
+
+pipeline_factory::pipeline_factory(vk::Device &device, pipeline_cache *vkw_pipeline_cache, thread_pool *compile_threads)
+	: vk_device{ device }, vkw_pipeline_cache{ vkw_pipeline_cache }, compile_threads{ compile_threads }, layouts{ device }
+{ }
+
+pipeline_factory::~pipeline_factory() = default;
+
+auto pipeline_factory::get(const pipeline_descriptor &desc) -> std::shared_ptr<pipeline>
+{
+	return get_async(desc).wait();
+}
+
+auto pipeline_factory::get_async(const pipeline_descriptor &desc) -> pipeline_handle
+{
+	using compile_task = std::packaged_task<std::shared_ptr<pipeline>()>;
+
+	auto key = hash(desc);
+	auto compile = std::shared_ptr<compile_task>{};
+	auto compiled = std::shared_future<std::shared_ptr<pipeline>>{};
+	{
+		auto lock = std::scoped_lock(entries_mutex);
+		auto &bucket = entries[key];
+
+		auto it = std::ranges::find_if(bucket, [&](const entry &e)
+		{
+			return std::get<pipeline_descriptor>(e) == desc;
+		});
+		if (it != bucket.end())
+		{
+			return pipeline_handle(std::get<1>(*it));
+		}
+
+		// registered before compiling, so concurrent requests for same descriptor wait on this one
+		compile = std::make_shared<compile_task>([this, desc]()
+		{
+			auto scope = trace_scope("pipeline_factory: compile pipeline");
+			return std::make_shared<pipeline>(vk_device, vkw_pipeline_cache->get(), layouts, desc);
+		});
+		compiled = compile->get_future().share();
+		bucket.emplace_back(desc, compiled);
+	}
+
+	if (compile_threads)
+	{
+		compile_threads->submit([compile]() { (*compile)(); });
+	}
+	else
+	{
+		(*compile)();
+	}
+
+	return pipeline_handle(std::move(compiled));
+}
+
+auto pipeline_factory::size() const -> size_t
+{
+	auto lock = std::scoped_lock(entries_mutex);
+	return std::accumulate(entries.begin(), entries.end(), size_t{ 0 }, [](size_t total, auto &&bucket)
+	{
+		return total + bucket.second.size();
+	});
+}
+
+auto pipeline_factory::create_compute(const compute_pipeline_descriptor &desc) -> std::unique_ptr<compute_pipeline>
+{
+	return std::make_unique<compute_pipeline>(vk_device, vkw_pipeline_cache->get(), layouts, desc);
+}
+
+void pipeline_factory::erase(const pipeline_descriptor &desc)
+{
+	auto key = hash(desc);
+
+	auto lock = std::scoped_lock(entries_mutex);
+	auto bucket = entries.find(key);
+	if (bucket == entries.end())
+	{
+		return;
+	}
+
+	std::erase_if(bucket->second, [&](const entry &e)
+	{
+		return std::get<pipeline_descriptor>(e) == desc;
+	});
+	if (bucket->second.empty())
+	{
+		entries.erase(bucket);
+	}
+}
+
+void pipeline_factory::clear()
+{
+	auto lock = std::scoped_lock(entries_mutex);
+	entries.clear();
+}
@@ -1,31 +1,169 @@
 #pragma once
 
-namespace Vulkan_eg::vkw
+#include "shader_code.hpp"
+#include "layout_cache.hpp"
+
+namespace vulkan_eg
+{
+	class thread_pool;
+}
+
+namespace vulkan_eg::vkw
 {
+	class pipeline_cache;
+
+	// One vertex buffer binding, its inputs interleaved in the order listed
+	struct vertex_stream
+	{
+		std::vector<uint32_t> locations;
+		vk::VertexInputRate input_rate{vk::VertexInputRate::eVertex};
+
+		auto operator==(const vertex_stream &) const -> bool = default;
+	};
+
 	struct pipeline_descriptor
 	{
-		using file_data = std::vector<uint32_t>;
+		std::vector<std::tuple<vk::ShaderStageFlagBits, shader_code>> shaders;
+		vk::PrimitiveTopology topology{vk::PrimitiveTopology::eTriangleList};
+		vk::PolygonMode polygon_mode{vk::PolygonMode::eFill};
+		vk::CullModeFlags cull_mode{vk::CullModeFlagBits::eBack};
+		vk::FrontFace front_face{vk::FrontFace::eClockwise};
+		bool blend_enable{false};                 // standard alpha blending on all color attachments
+		std::vector<vk::Format> color_formats;    // one per color attachment
+		vk::RenderPass render_pass;               // null for dynamic rendering, color_formats then describe the attachments
+		std::vector<std::tuple<uint32_t, uint32_t>> specialization_constants; // constant_id, 32-bit value
+		std::vector<std::tuple<uint32_t, uint32_t>> dynamic_buffers;          // set, binding of buffers bound with dynamic offsets
+		// binding N reads vertex_streams[N], empty interleaves every input in one per vertex binding
+		std::vector<vertex_stream> vertex_streams;
+		std::vector<std::tuple<uint32_t, vk::Format>> vertex_formats;         // location, format replacing reflected one (e.g. packed unorm)
+		std::vector<std::tuple<uint32_t, vk::DescriptorSetLayout>> external_sets; // set, layout replacing reflected one (e.g. bindless_heap)
+
+		auto operator==(const pipeline_descriptor &) const -> bool = default;
+	};
+
+	[[nodiscard]] auto hash(const pipeline_descriptor &desc) -> size_t;
 
-		std::vector<std::tuple<vk::ShaderStageFlags, file_data>> shaders;
-		vk::PrimitiveTopology topology;
-		vk::PolygonMode polygon_mode;
-		vk::CullModeFlags cull_mode;
-		vk::FrontFace front_face;
+	struct compute_pipeline_descriptor
+	{
+		shader_code shader;
+		std::vector<std::tuple<uint32_t, uint32_t>> specialization_constants; // constant_id, 32-bit value
+		std::vector<std::tuple<uint32_t, uint32_t>> dynamic_buffers;          // set, binding of buffers bound with dynamic offsets
+		std::vector<std::tuple<uint32_t, vk::DescriptorSetLayout>> external_sets; // set, layout replacing reflected one (e.g. bindless_heap)
 	};
 
 	class pipeline
 	{
 	public:
 		pipeline() = delete;
-		pipeline(vk::Device &device, const pipeline_descriptor &desc);
+		// layout and vertex input are derived from reflecting the shaders
+		pipeline(vk::Device &device, vk::PipelineCache cache, layout_cache &layouts, const pipeline_descriptor &desc);
 		~pipeline();
 
+		pipeline(const pipeline &) = delete;
+		auto operator=(const pipeline &) -> pipeline & = delete;
+
+		[[nodiscard]] auto get() const -> vk::Pipeline;
+		// shared with every pipeline of the same signature, owned by layout_cache
+		[[nodiscard]] auto get_layout() const -> vk::PipelineLayout;
+		[[nodiscard]] auto get_set_layouts() const -> const std::vector<vk::DescriptorSetLayout> &;
+		// milliseconds spent creating shader modules and pipeline
+		[[nodiscard]] auto get_creation_time() const -> double;
+
+	private:
+		void create_pipeline(vk::PipelineCache cache, layout_cache &layouts, const pipeline_descriptor &desc);
+
 	private:
-		void create_pipeline(const pipeline_descriptor &desc);
+		vk::Device vk_device;
+		pipeline_layout vk_pipeline_layout;
+		vk::Pipeline vk_pipeline;
+		double creation_time{};
+	};
+
+	class compute_pipeline
+	{
+	public:
+		compute_pipeline() = delete;
+		// layout is derived from reflecting the shader
+		compute_pipeline(vk::Device &device, vk::PipelineCache cache, layout_cache &layouts, const compute_pipeline_descriptor &desc);
+		~compute_pipeline();
+
+		compute_pipeline(const compute_pipeline &) = delete;
+		auto operator=(const compute_pipeline &) -> compute_pipeline & = delete;
+
+		[[nodiscard]] auto get() const -> vk::Pipeline;
+		// shared with every pipeline of the same signature, owned by layout_cache
+		[[nodiscard]] auto get_layout() const -> vk::PipelineLayout;
+		[[nodiscard]] auto get_set_layouts() const -> const std::vector<vk::DescriptorSetLayout> &;
+		// milliseconds spent creating shader module and pipeline
+		[[nodiscard]] auto get_creation_time() const -> double;
 
 	private:
 		vk::Device vk_device;
-		vk::PipelineLayout vk_pipeline_layout;
+		pipeline_layout vk_pipeline_layout;
 		vk::Pipeline vk_pipeline;
+		double creation_time{};
+	};
+
+	// Pipeline that may still be compiling on a worker thread
+	class pipeline_handle
+	{
+	public:
+		pipeline_handle() = default;
+		explicit pipeline_handle(std::shared_future<std::shared_ptr<pipeline>> compiled);
+
+		// true once compilation has finished, successfully or not
+		[[nodiscard]] auto is_ready() const -> bool;
+
+		// nullptr while still compiling, rethrows if compilation failed
+		[[nodiscard]] auto get() const -> pipeline *;
+
+		// blocks until compilation has finished
+		auto wait() const -> std::shared_ptr<pipeline>;
+
+	private:
+		std::shared_future<std::shared_ptr<pipeline>> compiled;
+	};
+
+	// Creates pipelines from descriptors, handing out the same pipeline for identical descriptors.
+	// Pipelines stay alive until the factory is destroyed or clear() is called and no one else holds them.
+	// With compile_threads, pipelines are compiled on the pool instead of the calling thread,
+	// pool must stop before factory is destroyed.
+	class pipeline_factory
+	{
+	public:
+		pipeline_factory(vk::Device &device, pipeline_cache *vkw_pipeline_cache, thread_pool *compile_threads = nullptr);
+		~pipeline_factory();
+
+		pipeline_factory() = delete;
+		pipeline_factory(const pipeline_factory &) = delete;
+		auto operator=(const pipeline_factory &) -> pipeline_factory & = delete;
+
+		// blocks until pipeline is compiled
+		[[nodiscard]] auto get(const pipeline_descriptor &desc) -> std::shared_ptr<pipeline>;
+
+		// returns immediately, a failed compile stays failed until clear()
+		[[nodiscard]] auto get_async(const pipeline_descriptor &desc) -> pipeline_handle;
+
+		// Compiled on calling thread and not shared, shares pipeline cache and layouts with graphics pipelines
+		[[nodiscard]] auto create_compute(const compute_pipeline_descriptor &desc) -> std::unique_ptr<compute_pipeline>;
+
+		// Forget pipeline for desc, it's destroyed once no handles to it remain
+		void erase(const pipeline_descriptor &desc);
+
+		// number of distinct pipelines held
+		[[nodiscard]] auto size() const -> size_t;
+
+		void clear();
+
+	private:
+		using entry = std::tuple<pipeline_descriptor, std::shared_future<std::shared_ptr<pipeline>>>;
+
+		vk::Device vk_device;
+		pipeline_cache *vkw_pipeline_cache;
+		thread_pool *compile_threads;
+		layout_cache layouts;
+
+		mutable std::mutex entries_mutex;
+		std::unordered_map<size_t, std::vector<entry>> entries; // bucketed by descriptor hash
 	};
 }
@@ -0,0 +1,135 @@
+#include "pipeline_cache.hpp"
+
+#include "devices.hpp"
+
+using namespace vulkan_eg::vkw;
+
+namespace
+{
+	// Layout of VkPipelineCacheHeaderVersionOne, at the start of all pipeline cache data
+	struct cache_header
+	{
+		uint32_t header_size;
+		uint32_t header_version;
+		uint32_t vendor_id;
+		uint32_t device_id;
+		std::array<uint8_t, VK_UUID_SIZE> pipeline_cache_uuid;
+	};
+	static_assert(sizeof(cache_header) == 16 + VK_UUID_SIZE);
+}
+
+pipeline_cache::pipeline_cache(devices *vkw_devices, std::filesystem::path file_path)
+	: path{ std::move(file_path) }
+{
+	vk_device = vkw_devices->get_device();
+	device_properties = vkw_devices->get_physical_device().getProperties();
+
+	auto data = load_file();
+	warm = is_compatible(data);
+	if (not warm)
+	{
+		// Stale or foreign cache, start empty rather than let driver reject it
+		data.clear();
+	}
+
+	auto cache_ci = vk::PipelineCacheCreateInfo
+	{
+		.initialDataSize = data.size(),
+		.pInitialData = data.data()
+	};
+
+	vk_pipeline_cache = vk_device.createPipelineCache(cache_ci);
+}
+
+pipeline_cache::~pipeline_cache()
+{
+	try
+	{
+		save();
+	}
+	catch (std::exception &err)
+	{
+		std::cerr << std::format("Failed to save pipeline cache: {}\n", err.what());
+	}
+
+	vk_device.destroyPipelineCache(vk_pipeline_cache);
+	vk_pipeline_cache = nullptr;
+}
+
+auto pipeline_cache::get() -> vk::PipelineCache &
+{
+	return vk_pipeline_cache;
+}
+
+auto pipeline_cache::is_warm() const -> bool
+{
+	return warm;
+}
+
+void pipeline_cache::save() const
+{
+	if (path.empty())
+	{
+		return;
+	}
+
+	auto data = vk_device.getPipelineCacheData(vk_pipeline_cache);
+
+	// Write next to target and rename over it, so a crash mid-write never leaves a truncated cache
+	auto temp_path = path;
+	temp_path += ".tmp";
+	{
+		auto file = std::ofstream(temp_path, std::ios::binary | std::ios::trunc);
+		if (not file.is_open())
+		{
+			throw std::runtime_error(std::format("Unable to open {}", temp_path.string()));
+		}
+		file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+		if (not file)
+		{
+			throw std::runtime_error(std::format("Unable to write {}", temp_path.string()));
+		}
+	}
+
+	std::filesystem::rename(temp_path, path);
+}
+
+auto pipeline_cache::load_file() const -> std::vector<uint8_t>
+{
+	if (path.empty() or not std::filesystem::exists(path))
+	{
+		return {};
+	}
+
+	auto file = std::ifstream(path, std::ios::ate | std::ios::binary);
+	if (not file.is_open())
+	{
+		return {};
+	}
+
+	auto file_size = static_cast<size_t>(file.tellg());
+	auto data = std::vector<uint8_t>(file_size);
+
+	file.seekg(0);
+	file.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(file_size));
+
+	return data;
+}
+
+auto pipeline_cache::is_compatible(const std::vector<uint8_t> &data) const -> bool
+{
+	if (data.size() < sizeof(cache_header))
+	{
+		return false;
+	}
+
+	auto header = cache_header{};
+	std::memcpy(&header, data.data(), sizeof(cache_header));
+
+	return header.header_size >= sizeof(cache_header)
+	   and header.header_size <= data.size()
+	   and header.header_version == static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne)
+	   and header.vendor_id == device_properties.vendorID
+	   and header.device_id == device_properties.deviceID
+	   and std::ranges::equal(header.pipeline_cache_uuid, device_properties.pipelineCacheUUID);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	class devices;
+
+	// vk::PipelineCache persisted to disk between runs.
+	// Data on disk is only used if its header matches this device and driver,
+	// and is written back atomically (write temporary file, then rename) on destruction.
+	class pipeline_cache
+	{
+	public:
+		// empty file_path keeps cache in memory only
+		pipeline_cache(devices *vkw_devices, std::filesystem::path file_path);
+		~pipeline_cache();
+
+		pipeline_cache() = delete;
+		pipeline_cache(const pipeline_cache &) = delete;
+		auto operator=(const pipeline_cache &) -> pipeline_cache & = delete;
+
+		[[nodiscard]] auto get() -> vk::PipelineCache &;
+
+		// true if valid data was loaded from disk
+		[[nodiscard]] auto is_warm() const -> bool;
+
+		void save() const;
+
+	private:
+		[[nodiscard]] auto load_file() const -> std::vector<uint8_t>;
+		[[nodiscard]] auto is_compatible(const std::vector<uint8_t> &data) const -> bool;
+
+	private:
+		std::filesystem::path path;
+		vk::PhysicalDeviceProperties device_properties;
+		vk::Device vk_device;
+		vk::PipelineCache vk_pipeline_cache;
+		bool warm{false};
+	};
+}
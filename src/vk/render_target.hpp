@@ -0,0 +1,26 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	// Anything renderer can draw into.
+	// Implemented by swap_chain (presentable) and offscreen_target (headless).
+	//
+	// Targets made for dynamic rendering have no render pass or frame buffers, get_render_pass returns
+	// a null handle and renderer draws straight into image views, transitioning images itself:
+	// from undefined to color attachment before rendering, to final_layout() after.
+	class render_target
+	{
+	public:
+		virtual ~render_target() = default;
+
+		[[nodiscard]] virtual auto get_render_pass() -> vk::RenderPass & = 0;
+		[[nodiscard]] virtual auto get_extent() -> vk::Extent2D = 0;
+		[[nodiscard]] virtual auto get_format() const -> vk::Format = 0;
+		[[nodiscard]] virtual auto frame_buffer(uint32_t index) -> vk::Framebuffer & = 0;
+		[[nodiscard]] virtual auto image_count() const -> uint32_t = 0;
+		[[nodiscard]] virtual auto image(uint32_t index) -> vk::Image & = 0;
+		[[nodiscard]] virtual auto image_view(uint32_t index) -> vk::ImageView & = 0;
+		// layout images are left in once rendered, what comes after (present, readback) expects it
+		[[nodiscard]] virtual auto final_layout() const -> vk::ImageLayout = 0;
+	};
+}
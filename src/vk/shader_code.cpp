@@ -0,0 +1,208 @@
+#include "shader_code.hpp"
+
+#if __has_include(<embedded_shaders.hpp>)
+#include <embedded_shaders.hpp>
+#define HAS_EMBEDDED_SHADERS
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace vulkan_eg::vkw;
+
+namespace
+{
+	// Read-only view of a whole file, unmapped on destruction
+	struct file_mapping
+	{
+		const void *data{nullptr};
+		size_t size{0};
+#ifdef _WIN32
+		HANDLE file{INVALID_HANDLE_VALUE};
+		HANDLE mapping{nullptr};
+#endif
+
+		file_mapping() = default;
+		file_mapping(const file_mapping &) = delete;
+		auto operator=(const file_mapping &) -> file_mapping & = delete;
+
+		~file_mapping()
+		{
+#ifdef _WIN32
+			if (data)
+			{
+				UnmapViewOfFile(data);
+			}
+			if (mapping)
+			{
+				CloseHandle(mapping);
+			}
+			if (file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(file);
+			}
+#else
+			if (data)
+			{
+				munmap(const_cast<void *>(data), size);
+			}
+#endif
+		}
+	};
+
+	auto map_read_only(const std::filesystem::path &path) -> std::shared_ptr<file_mapping>
+	{
+		auto view = std::make_shared<file_mapping>();
+		auto fail = [&]()
+		{
+			throw std::runtime_error(std::format("failed to map shader file {}", path.string()));
+		};
+
+#ifdef _WIN32
+		view->file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, 
+		                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (view->file == INVALID_HANDLE_VALUE)
+		{
+			fail();
+		}
+
+		auto size = LARGE_INTEGER{};
+		GetFileSizeEx(view->file, &size);
+		view->size = static_cast<size_t>(size.QuadPart);
+		if (view->size == 0)
+		{
+			fail();
+		}
+
+		view->mapping = CreateFileMappingW(view->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (not view->mapping)
+		{
+			fail();
+		}
+
+		view->data = MapViewOfFile(view->mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			fail();
+		}
+
+		struct stat file_stat{};
+		if (fstat(fd, &file_stat) != 0 or file_stat.st_size == 0)
+		{
+			close(fd);
+			fail();
+		}
+		view->size = static_cast<size_t>(file_stat.st_size);
+
+		// mapping keeps its own reference to the file
+		auto data = mmap(nullptr, view->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		view->data = (data == MAP_FAILED) ? nullptr : data;
+#endif
+		if (not view->data)
+		{
+			fail();
+		}
+
+		return view;
+	}
+
+	auto find_embedded(const std::filesystem::path &spv_path) -> std::optional<std::span<const uint32_t>>
+	{
+#ifdef HAS_EMBEDDED_SHADERS
+		auto name = spv_path.generic_string();
+		for (auto &&[embedded_name, words] : embedded_shaders::all)
+		{
+			if (embedded_name == name)
+			{
+				return words;
+			}
+		}
+#endif
+		return std::nullopt;
+	}
+}
+
+shader_code::shader_code(std::span<const uint32_t> embedded_words, std::string name)
+	: code{ embedded_words }, name{ std::move(name) }
+{ }
+
+auto shader_code::load(const std::filesystem::path &spv_path, bool replaceable) -> shader_code
+{
+	if (auto embedded = find_embedded(spv_path))
+	{
+		return shader_code(*embedded, spv_path.generic_string());
+	}
+	return replaceable ? read_file(spv_path) : map_file(spv_path);
+}
+
+auto shader_code::map_file(const std::filesystem::path &spv_path, std::string name) -> shader_code
+{
+	auto view = map_read_only(spv_path);
+	if (view->size % sizeof(uint32_t) != 0)
+	{
+		throw std::runtime_error(std::format("{} is not a SPIR-V file", spv_path.string()));
+	}
+
+	auto result = shader_code{};
+	// page aligned, so safe to view as words
+	result.code = std::span(static_cast<const uint32_t *>(view->data), view->size / sizeof(uint32_t));
+	result.mapping = std::move(view);
+	result.name = name.empty() ? spv_path.generic_string() : std::move(name);
+	return result;
+}
+
+auto shader_code::read_file(const std::filesystem::path &spv_path, std::string name) -> shader_code
+{
+	auto file = std::ifstream(spv_path, std::ios::ate | std::ios::binary);
+	if (not file.is_open())
+	{
+		throw std::runtime_error(std::format("failed to read shader file {}", spv_path.string()));
+	}
+
+	auto file_size = static_cast<size_t>(file.tellg());
+	if (file_size == 0 or file_size % sizeof(uint32_t) != 0)
+	{
+		throw std::runtime_error(std::format("{} is not a SPIR-V file", spv_path.string()));
+	}
+
+	auto words = std::make_shared<std::vector<uint32_t>>(file_size / sizeof(uint32_t));
+	file.seekg(0);
+	file.read(reinterpret_cast<char *>(words->data()), static_cast<std::streamsize>(file_size));
+	if (not file)
+	{
+		throw std::runtime_error(std::format("failed to read shader file {}", spv_path.string()));
+	}
+
+	auto result = shader_code{};
+	result.code = std::span<const uint32_t>(*words);
+	result.mapping = std::move(words);
+	result.name = name.empty() ? spv_path.generic_string() : std::move(name);
+	return result;
+}
+
+auto shader_code::words() const -> std::span<const uint32_t>
+{
+	return code;
+}
+
+auto shader_code::size_bytes() const -> size_t
+{
+	return code.size_bytes();
+}
+
+auto shader_code::get_name() const -> const std::string &
+{
+	return name;
+}
+
+auto shader_code::operator==(const shader_code &other) const -> bool
+{
+	return std::ranges::equal(code, other.code);
+}
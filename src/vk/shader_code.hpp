@@ -0,0 +1,37 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	// SPIR-V words handed straight to vkCreateShaderModule without a heap copy.
+	// Either points at a blob embedded in the binary, or at a read-only memory mapped file.
+	// Copies share the mapping, which is released with the last copy.
+	// Files that get replaced while in use (hot reload) are read into memory instead,
+	// as Windows can't replace a file while a view of it is mapped.
+	class shader_code
+	{
+	public:
+		shader_code() = default;
+		shader_code(std::span<const uint32_t> embedded_words, std::string name);
+
+		// Embedded blob compiled from this path if there is one, otherwise mapped from disk,
+		// or read from disk with replaceable, so file can be replaced while code is in use
+		[[nodiscard]] static auto load(const std::filesystem::path &spv_path, bool replaceable = false) -> shader_code;
+		// Always mapped from disk, bypassing embedded blobs. Empty name uses spv_path.
+		[[nodiscard]] static auto map_file(const std::filesystem::path &spv_path, std::string name = {}) -> shader_code;
+		// Always read from disk into memory, bypassing embedded blobs. Empty name uses spv_path.
+		[[nodiscard]] static auto read_file(const std::filesystem::path &spv_path, std::string name = {}) -> shader_code;
+
+		[[nodiscard]] auto words() const -> std::span<const uint32_t>;
+		[[nodiscard]] auto size_bytes() const -> size_t;
+		// path it was loaded as, e.g. "shaders/simple_shader.vert.spv"
+		[[nodiscard]] auto get_name() const -> const std::string &;
+
+		// compares code only
+		auto operator==(const shader_code &other) const -> bool;
+
+	private:
+		std::span<const uint32_t> code;
+		std::string name;
+		std::shared_ptr<const void> mapping;  // file mapping or words read from file, whichever code points at
+	};
+}
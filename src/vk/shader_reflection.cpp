@@ -0,0 +1,504 @@
+#include "shader_reflection.hpp"
+
+#include "hash.hpp"
+
+using namespace vulkan_eg::vkw;
+
+namespace
+{
+	// Subset of SPIR-V needed for interface reflection, values from the SPIR-V specification
+	constexpr auto spirv_magic = uint32_t{ 0x07230203 };
+	constexpr auto spirv_header_words = size_t{ 5 };
+
+	enum op : uint16_t
+	{
+		op_decorate = 71,
+		op_member_decorate = 72,
+		op_type_bool = 20,
+		op_type_int = 21,
+		op_type_float = 22,
+		op_type_vector = 23,
+		op_type_matrix = 24,
+		op_type_image = 25,
+		op_type_sampler = 26,
+		op_type_sampled_image = 27,
+		op_type_array = 28,
+		op_type_runtime_array = 29,
+		op_type_struct = 30,
+		op_type_pointer = 32,
+		op_constant = 43,
+		op_spec_constant_true = 48,
+		op_spec_constant_false = 49,
+		op_spec_constant = 50,
+		op_variable = 59,
+		op_type_acceleration_structure = 5341,
+	};
+
+	enum decoration : uint32_t
+	{
+		decoration_spec_id = 1,
+		decoration_block = 2,
+		decoration_buffer_block = 3,
+		decoration_array_stride = 6,
+		decoration_matrix_stride = 7,
+		decoration_built_in = 11,
+		decoration_location = 30,
+		decoration_binding = 33,
+		decoration_descriptor_set = 34,
+		decoration_offset = 35,
+	};
+
+	enum storage_class : uint32_t
+	{
+		storage_uniform_constant = 0,
+		storage_input = 1,
+		storage_uniform = 2,
+		storage_push_constant = 9,
+		storage_storage_buffer = 12,
+	};
+
+	constexpr auto dim_buffer = uint32_t{ 5 };
+	constexpr auto dim_subpass_data = uint32_t{ 6 };
+
+	struct id_info
+	{
+		uint16_t opcode{};
+		std::vector<uint32_t> operands;   // operands after the result id
+
+		// decorations
+		std::optional<uint32_t> spec_id, array_stride, location, binding, set;
+		bool block{}, buffer_block{}, built_in{};
+		std::vector<uint32_t> member_offsets;
+		std::vector<uint32_t> member_matrix_strides;
+	};
+
+	class module_info
+	{
+	public:
+		explicit module_info(std::span<const uint32_t> words)
+		{
+			if (words.size() < spirv_header_words or words[0] != spirv_magic)
+			{
+				throw std::runtime_error("Shader code is not SPIR-V");
+			}
+
+			ids.resize(words[3]); // id bound
+
+			for (auto i = spirv_header_words; i < words.size();)
+			{
+				auto word_count = words[i] >> 16;
+				auto opcode = static_cast<uint16_t>(words[i] & 0xffff);
+				if (word_count == 0 or i + word_count > words.size())
+				{
+					throw std::runtime_error("Malformed SPIR-V instruction");
+				}
+				parse(opcode, words.subspan(i + 1, word_count - 1));
+				i += word_count;
+			}
+		}
+
+		[[nodiscard]] auto at(uint32_t id) const -> const id_info &
+		{
+			return ids.at(id);
+		}
+
+		[[nodiscard]] auto variables() const -> std::vector<uint32_t>
+		{
+			auto out = std::vector<uint32_t>{};
+			for (auto id = 0u; id < ids.size(); ++id)
+			{
+				if (ids[id].opcode == op_variable)
+				{
+					out.push_back(id);
+				}
+			}
+			return out;
+		}
+
+		[[nodiscard]] auto spec_constants() const -> std::vector<uint32_t>
+		{
+			auto out = std::vector<uint32_t>{};
+			for (auto id = 0u; id < ids.size(); ++id)
+			{
+				auto opcode = ids[id].opcode;
+				if ((opcode == op_spec_constant or opcode == op_spec_constant_true or opcode == op_spec_constant_false)
+				    and ids[id].spec_id)
+				{
+					out.push_back(id);
+				}
+			}
+			return out;
+		}
+
+		// byte size of a type as laid out in a block, using Offset/ArrayStride/MatrixStride decorations
+		[[nodiscard]] auto size_of(uint32_t type_id, uint32_t matrix_stride = 0) const -> uint32_t
+		{
+			auto &type = at(type_id);
+			switch (type.opcode)
+			{
+			case op_type_bool:
+				return 4;
+			case op_type_int:
+			case op_type_float:
+				return type.operands.at(0) / 8;
+			case op_type_vector:
+				return size_of(type.operands.at(0)) * type.operands.at(1);
+			case op_type_matrix:
+			{
+				auto column_size = matrix_stride ? matrix_stride : size_of(type.operands.at(0));
+				return column_size * type.operands.at(1);
+			}
+			case op_type_array:
+			{
+				auto stride = type.array_stride.value_or(size_of(type.operands.at(0)));
+				return stride * constant_value(type.operands.at(1));
+			}
+			case op_type_runtime_array:
+				return 0;
+			case op_type_struct:
+			{
+				auto size = 0u;
+				for (auto member = 0u; member < type.operands.size(); ++member)
+				{
+					auto offset = member < type.member_offsets.size() ? type.member_offsets[member] : size;
+					auto stride = member < type.member_matrix_strides.size() ? type.member_matrix_strides[member] : 0u;
+					size = std::max(size, offset + size_of(type.operands[member], stride));
+				}
+				return size;
+			}
+			default:
+				throw std::runtime_error(std::format("Unsupported SPIR-V type {} in block", type.opcode));
+			}
+		}
+
+		[[nodiscard]] auto constant_value(uint32_t id) const -> uint32_t
+		{
+			auto &constant = at(id);
+			if (constant.opcode != op_constant and constant.opcode != op_spec_constant)
+			{
+				throw std::runtime_error("SPIR-V array length is not a constant");
+			}
+			return constant.operands.at(1); // operands: result type, value
+		}
+
+	private:
+		void parse(uint16_t opcode, std::span<const uint32_t> operands)
+		{
+			switch (opcode)
+			{
+			case op_decorate:
+				decorate(ids.at(operands[0]), operands.subspan(1));
+				break;
+			case op_member_decorate:
+				member_decorate(ids.at(operands[0]), operands[1], operands.subspan(2));
+				break;
+			case op_type_bool:
+			case op_type_int:
+			case op_type_float:
+			case op_type_vector:
+			case op_type_matrix:
+			case op_type_image:
+			case op_type_sampler:
+			case op_type_sampled_image:
+			case op_type_array:
+			case op_type_runtime_array:
+			case op_type_struct:
+			case op_type_pointer:
+			case op_type_acceleration_structure:
+				// result id first
+				define(operands[0], opcode, operands.subspan(1));
+				break;
+			case op_constant:
+			case op_spec_constant_true:
+			case op_spec_constant_false:
+			case op_spec_constant:
+			case op_variable:
+				// result type, then result id
+				define(operands[1], opcode, operands);
+				ids.at(operands[1]).operands.erase(ids.at(operands[1]).operands.begin() + 1);
+				break;
+			default:
+				break;
+			}
+		}
+
+		void define(uint32_t id, uint16_t opcode, std::span<const uint32_t> operands)
+		{
+			auto &info = ids.at(id);
+			info.opcode = opcode;
+			info.operands.assign(operands.begin(), operands.end());
+		}
+
+		static void decorate(id_info &info, std::span<const uint32_t> operands)
+		{
+			auto value = [&]() { return operands.at(1); };
+			switch (operands[0])
+			{
+			case decoration_spec_id:        info.spec_id = value(); break;
+			case decoration_block:          info.block = true; break;
+			case decoration_buffer_block:   info.buffer_block = true; break;
+			case decoration_array_stride:   info.array_stride = value(); break;
+			case decoration_built_in:       info.built_in = true; break;
+			case decoration_location:       info.location = value(); break;
+			case decoration_binding:        info.binding = value(); break;
+			case decoration_descriptor_set: info.set = value(); break;
+			default: break;
+			}
+		}
+
+		static void member_decorate(id_info &info, uint32_t member, std::span<const uint32_t> operands)
+		{
+			auto set_member = [&](std::vector<uint32_t> &values)
+			{
+				if (values.size() <= member)
+				{
+					values.resize(member + 1);
+				}
+				values[member] = operands.at(1);
+			};
+
+			switch (operands[0])
+			{
+			case decoration_offset:        set_member(info.member_offsets); break;
+			case decoration_matrix_stride: set_member(info.member_matrix_strides); break;
+			case decoration_built_in:      info.built_in = true; break; // gl_PerVertex style blocks
+			default: break;
+			}
+		}
+
+	private:
+		std::vector<id_info> ids;
+	};
+
+	auto vertex_format(const module_info &spirv, uint32_t type_id) -> vk::Format
+	{
+		using fmt = vk::Format;
+		auto &type = spirv.at(type_id);
+
+		auto component_id = type_id;
+		auto components = 1u;
+		if (type.opcode == op_type_vector)
+		{
+			component_id = type.operands.at(0);
+			components = type.operands.at(1);
+		}
+
+		auto &component = spirv.at(component_id);
+		if ((component.opcode != op_type_float and component.opcode != op_type_int)
+		    or component.operands.at(0) != 32 or components > 4)
+		{
+			throw std::runtime_error("Unsupported vertex input type, only 32-bit scalars and vectors are handled");
+		}
+
+		constexpr auto float_formats = std::array{ fmt::eR32Sfloat, fmt::eR32G32Sfloat, fmt::eR32G32B32Sfloat, fmt::eR32G32B32A32Sfloat };
+		constexpr auto sint_formats = std::array{ fmt::eR32Sint, fmt::eR32G32Sint, fmt::eR32G32B32Sint, fmt::eR32G32B32A32Sint };
+		constexpr auto uint_formats = std::array{ fmt::eR32Uint, fmt::eR32G32Uint, fmt::eR32G32B32Uint, fmt::eR32G32B32A32Uint };
+
+		if (component.opcode == op_type_float)
+		{
+			return float_formats.at(components - 1);
+		}
+		auto is_signed = component.operands.at(1) != 0;
+		return is_signed ? sint_formats.at(components - 1) : uint_formats.at(components - 1);
+	}
+
+	// descriptor type and array count of a resource variable's pointee type
+	auto descriptor_type(const module_info &spirv, uint32_t storage, uint32_t type_id)
+		-> std::tuple<vk::DescriptorType, uint32_t>
+	{
+		using dt = vk::DescriptorType;
+
+		auto count = 1u;
+		auto *type = &spirv.at(type_id);
+		if (type->opcode == op_type_array)
+		{
+			count = spirv.constant_value(type->operands.at(1));
+			type = &spirv.at(type->operands.at(0));
+		}
+		else if (type->opcode == op_type_runtime_array)
+		{
+			count = 0;
+			type = &spirv.at(type->operands.at(0));
+		}
+
+		switch (type->opcode)
+		{
+		case op_type_struct:
+			if (storage == storage_storage_buffer or type->buffer_block)
+			{
+				return { dt::eStorageBuffer, count };
+			}
+			return { dt::eUniformBuffer, count };
+		case op_type_sampler:
+			return { dt::eSampler, count };
+		case op_type_sampled_image:
+			return { dt::eCombinedImageSampler, count };
+		case op_type_image:
+		{
+			// operands: sampled type, dim, depth, arrayed, ms, sampled, format
+			auto dim = type->operands.at(1);
+			auto is_storage = type->operands.at(5) == 2;
+			if (dim == dim_buffer)
+			{
+				return { is_storage ? dt::eStorageTexelBuffer : dt::eUniformTexelBuffer, count };
+			}
+			if (dim == dim_subpass_data)
+			{
+				return { dt::eInputAttachment, count };
+			}
+			return { is_storage ? dt::eStorageImage : dt::eSampledImage, count };
+		}
+		case op_type_acceleration_structure:
+			return { dt::eAccelerationStructureKHR, count };
+		default:
+			throw std::runtime_error(std::format("Unsupported SPIR-V descriptor type {}", type->opcode));
+		}
+	}
+}
+
+auto vulkan_eg::vkw::reflect(vk::ShaderStageFlagBits stage, std::span<const uint32_t> words) -> shader_reflection
+{
+	auto spirv = module_info(words);
+	auto out = shader_reflection{ .stage = stage };
+
+	for (auto id : spirv.variables())
+	{
+		auto &variable = spirv.at(id);
+		auto storage = variable.operands.at(1);                     // result type, storage class
+		auto &pointer = spirv.at(variable.operands.at(0));
+		auto type_id = pointer.operands.at(1);                      // storage class, pointee type
+
+		switch (storage)
+		{
+		case storage_input:
+			if (stage == vk::ShaderStageFlagBits::eVertex and variable.location and not variable.built_in
+			    and not spirv.at(type_id).built_in)
+			{
+				out.vertex_inputs.push_back({ .location = *variable.location, .format = vertex_format(spirv, type_id) });
+			}
+			break;
+		case storage_uniform_constant:
+		case storage_uniform:
+		case storage_storage_buffer:
+		{
+			if (not variable.binding)
+			{
+				break;
+			}
+			auto [type, count] = descriptor_type(spirv, storage, type_id);
+			out.bindings.push_back(
+			{
+				.set = variable.set.value_or(0),
+				.binding = *variable.binding,
+				.type = type,
+				.count = count,
+				.stages = stage
+			});
+			break;
+		}
+		case storage_push_constant:
+			out.push_constants = vk::PushConstantRange
+			{
+				.stageFlags = stage,
+				.offset = 0,
+				.size = spirv.size_of(type_id)
+			};
+			break;
+		default:
+			break;
+		}
+	}
+
+	for (auto id : spirv.spec_constants())
+	{
+		auto &constant = spirv.at(id);
+		out.specialization_constants.push_back(
+		{
+			.constant_id = *constant.spec_id,
+			.size = spirv.size_of(constant.operands.at(0))
+		});
+	}
+
+	std::ranges::sort(out.vertex_inputs, {}, &vertex_input::location);
+	return out;
+}
+
+auto vulkan_eg::vkw::merge(std::span<const shader_reflection> stages) -> layout_signature
+{
+	auto out = layout_signature{};
+
+	for (auto &stage : stages)
+	{
+		for (auto &binding : stage.bindings)
+		{
+			auto existing = std::ranges::find_if(out.bindings, [&](auto &&b)
+			{
+				return b.set == binding.set and b.binding == binding.binding;
+			});
+
+			if (existing == out.bindings.end())
+			{
+				out.bindings.push_back(binding);
+				continue;
+			}
+
+			if (existing->type != binding.type or existing->count != binding.count)
+			{
+				throw std::runtime_error(std::format("Shader stages disagree on set {} binding {}", binding.set, binding.binding));
+			}
+			existing->stages |= binding.stages;
+		}
+
+		// one range covering every stage's block keeps layout compatible across stage combinations
+		if (stage.push_constants)
+		{
+			if (out.push_constants.empty())
+			{
+				out.push_constants.push_back(*stage.push_constants);
+			}
+			else
+			{
+				auto &range = out.push_constants.front();
+				range.stageFlags |= stage.push_constants->stageFlags;
+				range.size = std::max(range.size, stage.push_constants->size);
+			}
+		}
+	}
+
+	std::ranges::sort(out.bindings, [](auto &&a, auto &&b)
+	{
+		return std::tie(a.set, a.binding) < std::tie(b.set, b.binding);
+	});
+	return out;
+}
+
+auto vulkan_eg::vkw::hash(std::span<const descriptor_binding> bindings) -> size_t
+{
+	auto seed = size_t{ 0 };
+	for (auto &binding : bindings)
+	{
+		hash_combine(seed, binding.set);
+		hash_combine(seed, binding.binding);
+		hash_combine(seed, static_cast<uint32_t>(binding.type));
+		hash_combine(seed, binding.count);
+		hash_combine(seed, static_cast<uint32_t>(binding.stages));
+	}
+	return seed;
+}
+
+auto vulkan_eg::vkw::hash(const layout_signature &signature) -> size_t
+{
+	auto seed = hash(signature.bindings);
+	for (auto &range : signature.push_constants)
+	{
+		hash_combine(seed, static_cast<uint32_t>(range.stageFlags));
+		hash_combine(seed, range.offset);
+		hash_combine(seed, range.size);
+	}
+	for (auto &&[set, set_layout] : signature.external_sets)
+	{
+		hash_combine(seed, set);
+		hash_combine(seed, static_cast<VkDescriptorSetLayout>(set_layout));
+	}
+	return seed;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	struct vertex_input
+	{
+		uint32_t location;
+		vk::Format format;
+
+		auto operator==(const vertex_input &) const -> bool = default;
+	};
+
+	struct descriptor_binding
+	{
+		uint32_t set;
+		uint32_t binding;
+		vk::DescriptorType type;
+		uint32_t count;               // 0 for runtime sized arrays
+		vk::ShaderStageFlags stages;
+
+		auto operator==(const descriptor_binding &) const -> bool = default;
+	};
+
+	struct specialization_constant
+	{
+		uint32_t constant_id;
+		uint32_t size;                // bytes
+	};
+
+	// Interface of one shader stage, read from its SPIR-V
+	struct shader_reflection
+	{
+		vk::ShaderStageFlagBits stage;
+		std::vector<vertex_input> vertex_inputs;          // vertex stage only, sorted by location
+		std::vector<descriptor_binding> bindings;
+		std::optional<vk::PushConstantRange> push_constants;
+		std::vector<specialization_constant> specialization_constants;
+	};
+
+	// Combined interface of all stages in a pipeline, what its pipeline layout is built from
+	struct layout_signature
+	{
+		std::vector<descriptor_binding> bindings;         // sorted by set, then binding
+		std::vector<vk::PushConstantRange> push_constants;
+		// set, layout owned elsewhere used as is, sorted by set. Has no bindings in bindings.
+		std::vector<std::tuple<uint32_t, vk::DescriptorSetLayout>> external_sets;
+
+		auto operator==(const layout_signature &) const -> bool = default;
+	};
+
+	// Throws std::runtime_error if words are not SPIR-V
+	[[nodiscard]] auto reflect(vk::ShaderStageFlagBits stage, std::span<const uint32_t> words) -> shader_reflection;
+	[[nodiscard]] auto merge(std::span<const shader_reflection> stages) -> layout_signature;
+
+	[[nodiscard]] auto hash(std::span<const descriptor_binding> bindings) -> size_t;
+	[[nodiscard]] auto hash(const layout_signature &signature) -> size_t;
+}
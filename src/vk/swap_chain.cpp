@@ -2,6 +2,7 @@
 
 #include "instance.hpp"
 #include "devices.hpp"
+#include "startup_trace.hpp"
 
 using namespace vulkan_eg::vkw;
 
@@ -23,21 +24,31 @@ namespace
 		return *format_iter;
 	}
 
-	auto pick_present_mode(surface_details &sd) -> vk::PresentModeKHR
+	// first supported mode in order of preference, FIFO is required to be supported so it's the fallback
+	auto pick_present_mode(surface_details &sd, const std::vector<vk::PresentModeKHR> &preferred_modes) -> vk::PresentModeKHR
 	{
-		auto mode_iter = std::ranges::find_if(sd.present_modes, [](const vk::PresentModeKHR &pm)
+		auto mode_iter = std::ranges::find_if(preferred_modes, [&](const vk::PresentModeKHR &pm)
 		{
-			return pm == vk::PresentModeKHR::eFifoRelaxed;
+			return std::ranges::find(sd.present_modes, pm) != sd.present_modes.end();
 		});
 
-		if (mode_iter == sd.present_modes.end())
+		if (mode_iter == preferred_modes.end())
 		{
-			throw std::runtime_error("Unable to find desired surface format");
+			return vk::PresentModeKHR::eFifo;
 		}
 
 		return *mode_iter;
 	}
 
+	// one more image than frames in flight, so CPU can always acquire while the rest are queued.
+	// maxImageCount of 0 means there is no upper limit.
+	auto pick_image_count(surface_details &sd, uint32_t frames_in_flight) -> uint32_t
+	{
+		auto max_count = (sd.capabilities.maxImageCount == 0) ? std::numeric_limits<uint32_t>::max()
+		                                                       : sd.capabilities.maxImageCount;
+		return std::clamp(frames_in_flight + 1, sd.capabilities.minImageCount, max_count);
+	}
+
 	auto pick_surface_extent(surface_details &sd) -> vk::Extent2D
 	{
 		if (sd.capabilities.currentExtent.width == std::numeric_limits<uint32_t>::max())
@@ -59,36 +70,101 @@ auto vulkan_eg::vkw::query_surface_details(const vk::PhysicalDevice &device, con
 	};
 }
 
-swap_chain::swap_chain(const instance *vkw_inst, devices *vkw_devices)
+swap_chain::swap_chain(const instance *vkw_inst, devices *vkw_devices, 
+                       const std::vector<vk::PresentModeKHR> &present_modes, uint32_t frames_in_flight, bool with_render_pass)
+	: vkw_devices{ vkw_devices }, preferred_present_modes{ present_modes }, frames_in_flight{ frames_in_flight },
+	  with_render_pass{ with_render_pass }
 {
+	auto scope = trace_scope("swap_chain::swap_chain");
 	auto &&[instance, surface] = vkw_inst->get();
+	vk_surface = surface;
 	vk_device = vkw_devices->get_device();
 	auto physical_device = vkw_devices->get_physical_device();
 	auto qf = vkw_devices->get_queue_family();
 	create_swap_chain(physical_device, surface, qf);
 	create_images();
-	create_renderpass();
-	create_frame_buffers();
+	create_semaphores();
+	if (with_render_pass)
+	{
+		create_renderpass();
+		create_frame_buffers();
+	}
 }
 
 swap_chain::~swap_chain()
 {
+	for (auto &resources : retired)
+	{
+		destroy_retired(resources);
+	}
+	retired.clear();
 
+	destroy_semaphores();
 	destroy_frame_buffers();
 	destroy_images();
 	vk_device.destroyRenderPass(vk_render_pass);
 	vk_device.destroySwapchainKHR(vk_swap_chain);
 }
 
-void swap_chain::create_swap_chain(const vk::PhysicalDevice &device, const vk::SurfaceKHR &surface, const queue_family &qf)
+auto swap_chain::recreate(uint64_t last_submitted_frame) -> bool
 {
+	auto capabilities = vkw_devices->get_physical_device().getSurfaceCapabilitiesKHR(vk_surface);
+	if (capabilities.currentExtent.width == 0 or capabilities.currentExtent.height == 0)
+	{
+		return false;
+	}
+
+	// In flight frames may still reference these, so they can't be destroyed yet.
+	// Images are owned by the old swap chain and go away with it.
+	// Its presents may still be waiting on the render finished semaphores.
+	retired.push_back(retired_resources
+	{
+		.last_used_frame = last_submitted_frame,
+		.swap_chain = vk_swap_chain,
+		.image_views = std::exchange(vk_image_views, {}),
+		.frame_buffers = std::exchange(vk_frame_buffers, {}),
+		.render_finished_semaphores = std::exchange(vk_render_finished_semaphores, {})
+	});
+	vk_images.clear();
+
+	create_swap_chain(vkw_devices->get_physical_device(), vk_surface, vkw_devices->get_queue_family(), vk_swap_chain);
+	create_images();
+	create_semaphores();
+	if (with_render_pass)
+	{
+		create_frame_buffers();
+	}
+
+	return true;
+}
+
+void swap_chain::release_retired(uint64_t completed_frame)
+{
+	auto [first, last] = std::ranges::remove_if(retired, [&](retired_resources &resources)
+	{
+		if (resources.last_used_frame > completed_frame)
+		{
+			return false;
+		}
+
+		destroy_retired(resources);
+		return true;
+	});
+	retired.erase(first, last);
+}
+
+void swap_chain::create_swap_chain(const vk::PhysicalDevice &device, const vk::SurfaceKHR &surface, const queue_family &qf, 
+                                   vk::SwapchainKHR old_swap_chain)
+{
+	auto scope = trace_scope("swap_chain::create_swap_chain");
 	auto sd = query_surface_details(device, surface);
 	auto sf = pick_surface_format(sd);
-	auto pm = pick_present_mode(sd);
+	auto pm = pick_present_mode(sd, preferred_present_modes);
+	vk_present_mode = pm;
 	vk_sc_extent = pick_surface_extent(sd);
 	vk_sc_format = sf.format;
 
-	auto image_count = std::clamp(0u, sd.capabilities.minImageCount + 1, sd.capabilities.maxImageCount);
+	auto image_count = pick_image_count(sd, frames_in_flight);
 	auto ism = (qf.graphics_family == qf.present_family) ? vk::SharingMode::eExclusive : vk::SharingMode::eConcurrent;
 	auto qfl = (qf.graphics_family == qf.present_family) ? std::vector<uint32_t>{} 
 	                                                     : std::vector{qf.graphics_family.value(), qf.present_family.value()};
@@ -102,12 +178,14 @@ void swap_chain::create_swap_chain(const vk::PhysicalDevice &device, const vk::S
 		.imageExtent = vk_sc_extent,
 		.imageArrayLayers = 1, 
 		.imageUsage = vk::ImageUsageFlagBits::eColorAttachment,
+		.imageSharingMode = ism,
 		.queueFamilyIndexCount = static_cast<uint32_t>(qfl.size()),
 		.pQueueFamilyIndices = qfl.data(),
 		.preTransform = sd.capabilities.currentTransform,
 		.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
 		.presentMode = pm,
-		.clipped = true
+		.clipped = true,
+		.oldSwapchain = old_swap_chain
 	};
 
 	vk_swap_chain = vk_device.createSwapchainKHR(create_info);
@@ -116,6 +194,7 @@ void swap_chain::create_swap_chain(const vk::PhysicalDevice &device, const vk::S
 
 void swap_chain::create_images()
 {
+	auto scope = trace_scope("swap_chain::create_images");
 	vk_images = vk_device.getSwapchainImagesKHR(vk_swap_chain);
 	vk_image_views.resize(vk_images.size());
 
@@ -147,6 +226,7 @@ void swap_chain::create_images()
 
 void swap_chain::create_renderpass()
 {
+	auto scope = trace_scope("swap_chain::create_renderpass");
 	auto color_attachment = vk::AttachmentDescription
 	{
 		.format = vk_sc_format,
@@ -156,7 +236,7 @@ void swap_chain::create_renderpass()
 		.stencilLoadOp = vk::AttachmentLoadOp::eDontCare,
 		.stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
 		.initialLayout = vk::ImageLayout::eUndefined,
-		.finalLayout = vk::ImageLayout::ePresentSrcKHR
+		.finalLayout = final_layout()
 	};
 
 	auto color_attachment_ref = vk::AttachmentReference
@@ -197,6 +277,7 @@ void swap_chain::create_renderpass()
 
 void swap_chain::create_frame_buffers()
 {
+	auto scope = trace_scope("swap_chain::create_frame_buffers");
 	vk_frame_buffers.resize(vk_image_views.size());
 
 	for(auto &&[image_view, frame_buffer] : ranges::views::zip(vk_image_views, vk_frame_buffers))
@@ -233,6 +314,48 @@ void swap_chain::destroy_images()
 	}
 }
 
+void swap_chain::create_semaphores()
+{
+	vk_render_finished_semaphores.resize(vk_images.size());
+	for (auto &semaphore : vk_render_finished_semaphores)
+	{
+		semaphore = vk_device.createSemaphore(vk::SemaphoreCreateInfo{});
+	}
+}
+
+void swap_chain::destroy_retired(retired_resources &resources)
+{
+	for (auto &semaphore : resources.render_finished_semaphores)
+	{
+		vk_device.destroySemaphore(semaphore);
+	}
+	resources.render_finished_semaphores.clear();
+
+	for (auto &fb : resources.frame_buffers)
+	{
+		vk_device.destroyFramebuffer(fb);
+	}
+	resources.frame_buffers.clear();
+
+	for (auto &image_view : resources.image_views)
+	{
+		vk_device.destroyImageView(image_view);
+	}
+	resources.image_views.clear();
+
+	vk_device.destroySwapchainKHR(resources.swap_chain);
+	resources.swap_chain = nullptr;
+}
+
+void swap_chain::destroy_semaphores()
+{
+	for (auto &semaphore : vk_render_finished_semaphores)
+	{
+		vk_device.destroySemaphore(semaphore);
+	}
+	vk_render_finished_semaphores.clear();
+}
+
 void swap_chain::destroy_frame_buffers()
 {
 	for (auto &fb : vk_frame_buffers)
@@ -260,7 +383,42 @@ auto swap_chain::get_extent() -> vk::Extent2D
 	return vk_sc_extent;
 }
 
+auto swap_chain::get_format() const -> vk::Format
+{
+	return vk_sc_format;
+}
+
 auto swap_chain::frame_buffer(uint32_t index) -> vk::Framebuffer &
 {
 	return vk_frame_buffers.at(index);
-}
\ No newline at end of file
+}
+
+auto swap_chain::image_count() const -> uint32_t
+{
+	return static_cast<uint32_t>(vk_images.size());
+}
+
+auto swap_chain::image(uint32_t index) -> vk::Image &
+{
+	return vk_images.at(index);
+}
+
+auto swap_chain::image_view(uint32_t index) -> vk::ImageView &
+{
+	return vk_image_views.at(index);
+}
+
+auto swap_chain::final_layout() const -> vk::ImageLayout
+{
+	return vk::ImageLayout::ePresentSrcKHR;
+}
+
+auto swap_chain::get_present_mode() const -> vk::PresentModeKHR
+{
+	return vk_present_mode;
+}
+
+auto swap_chain::render_finished(uint32_t index) -> vk::Semaphore &
+{
+	return vk_render_finished_semaphores.at(index);
+}
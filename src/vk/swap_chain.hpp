@@ -1,5 +1,7 @@
 #pragma once
 
+#include "render_target.hpp"
+
 namespace vulkan_eg::vkw
 {
 	class instance;
@@ -16,36 +18,76 @@ namespace vulkan_eg::vkw
 	auto query_surface_details(const vk::PhysicalDevice &device, const vk::SurfaceKHR &surface)
 		-> surface_details;
 
-	class swap_chain
+	class swap_chain : public render_target
 	{
 	public:
-		swap_chain(const instance *vkw_inst, devices *vkw_devices);
-		~swap_chain();
+		// present_modes in order of preference, falls back to FIFO if none are supported.
+		// Without render pass, swap chain has no render pass or frame buffers and is drawn into with dynamic rendering,
+		// recreating it then only replaces images and views.
+		swap_chain(const instance *vkw_inst, devices *vkw_devices, 
+		           const std::vector<vk::PresentModeKHR> &present_modes, uint32_t frames_in_flight, bool with_render_pass = true);
+		~swap_chain() override;
 
 		swap_chain() = delete;
 
 		[[nodiscard]] auto get() -> vk::SwapchainKHR &;
-		[[nodiscard]] auto get_render_pass() -> vk::RenderPass &;
-		[[nodiscard]] auto get_extent() -> vk::Extent2D;
-		[[nodiscard]] auto frame_buffer(uint32_t index) -> vk::Framebuffer &;
+		[[nodiscard]] auto get_render_pass() -> vk::RenderPass & override;
+		[[nodiscard]] auto get_extent() -> vk::Extent2D override;
+		[[nodiscard]] auto get_format() const -> vk::Format override;
+		[[nodiscard]] auto frame_buffer(uint32_t index) -> vk::Framebuffer & override;
+		[[nodiscard]] auto image_count() const -> uint32_t override;
+		[[nodiscard]] auto image(uint32_t index) -> vk::Image & override;
+		[[nodiscard]] auto image_view(uint32_t index) -> vk::ImageView & override;
+		[[nodiscard]] auto final_layout() const -> vk::ImageLayout override;
+		[[nodiscard]] auto get_present_mode() const -> vk::PresentModeKHR;
+		// per image, as present may still be waiting on it when a frame slot comes around again
+		[[nodiscard]] auto render_finished(uint32_t index) -> vk::Semaphore &;
+
+		// Creates a new swap chain from the old one, old resources are kept alive until
+		// release_retired is called with a completed frame >= last_submitted_frame.
+		// Returns false, without touching the current swap chain, if the surface has zero extent (minimized).
+		[[nodiscard]] auto recreate(uint64_t last_submitted_frame) -> bool;
+		void release_retired(uint64_t completed_frame);
+
+	private:
+		struct retired_resources
+		{
+			uint64_t last_used_frame;
+			vk::SwapchainKHR swap_chain;
+			std::vector<vk::ImageView> image_views;
+			std::vector<vk::Framebuffer> frame_buffers;
+			std::vector<vk::Semaphore> render_finished_semaphores;
+		};
 
 	private:
-		void create_swap_chain(const vk::PhysicalDevice &device, const vk::SurfaceKHR &surface, const queue_family &qf);
+		void create_swap_chain(const vk::PhysicalDevice &device, const vk::SurfaceKHR &surface, const queue_family &qf, 
+		                       vk::SwapchainKHR old_swap_chain = nullptr);
 		void create_images();
 		void create_renderpass();
 		void create_frame_buffers();
+		void create_semaphores();
 
 		void destroy_images();
 		void destroy_frame_buffers();
+		void destroy_semaphores();
+		void destroy_retired(retired_resources &resources);
 
 	private:
+		devices *vkw_devices;
+		std::vector<vk::PresentModeKHR> preferred_present_modes;
+		uint32_t frames_in_flight;
+		bool with_render_pass;
+		vk::SurfaceKHR vk_surface;
 		vk::Device vk_device;
 		vk::SwapchainKHR vk_swap_chain;
 		vk::Format vk_sc_format;
 		vk::Extent2D vk_sc_extent;
+		vk::PresentModeKHR vk_present_mode;
 		vk::RenderPass vk_render_pass;
 		std::vector<vk::Image> vk_images;
 		std::vector<vk::ImageView> vk_image_views;
 		std::vector<vk::Framebuffer> vk_frame_buffers;
+		std::vector<vk::Semaphore> vk_render_finished_semaphores;
+		std::vector<retired_resources> retired;
 	};
 };
\ No newline at end of file
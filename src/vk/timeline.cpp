@@ -0,0 +1,79 @@
+#include "timeline.hpp"
+
+using namespace vulkan_eg::vkw;
+
+timeline::timeline(vk::Device &device, uint64_t initial_value)
+	: vk_device{ device }, last_completed{ initial_value }
+{
+	auto type_ci = vk::SemaphoreTypeCreateInfo
+	{
+		.semaphoreType = vk::SemaphoreType::eTimeline,
+		.initialValue = initial_value
+	};
+
+	auto semaphore_ci = vk::SemaphoreCreateInfo
+	{
+		.pNext = &type_ci
+	};
+
+	vk_semaphore = vk_device.createSemaphore(semaphore_ci);
+}
+
+timeline::~timeline()
+{
+	vk_device.destroySemaphore(vk_semaphore);
+	vk_semaphore = nullptr;
+}
+
+auto timeline::get() -> vk::Semaphore &
+{
+	return vk_semaphore;
+}
+
+auto timeline::completed_value() const -> uint64_t
+{
+	auto value = vk_device.getSemaphoreCounterValue(vk_semaphore);
+	advance(value);
+	return value;
+}
+
+auto timeline::is_complete(uint64_t value) const -> bool
+{
+	// value only ever increases, so skip querying the device when it's known to be reached
+	if (value <= last_completed.load(std::memory_order_relaxed))
+	{
+		return true;
+	}
+
+	return value <= completed_value();
+}
+
+void timeline::wait(uint64_t value) const
+{
+	if (is_complete(value))
+	{
+		return;
+	}
+
+	auto wait_info = vk::SemaphoreWaitInfo
+	{
+		.semaphoreCount = 1,
+		.pSemaphores = &vk_semaphore,
+		.pValues = &value
+	};
+
+	auto result = vk_device.waitSemaphores(wait_info, UINT64_MAX);
+	if (result != vk::Result::eSuccess)
+	{
+		throw std::runtime_error("Failed waiting on timeline semaphore.");
+	}
+
+	advance(value);
+}
+
+void timeline::advance(uint64_t value) const
+{
+	auto current = last_completed.load(std::memory_order_relaxed);
+	while (current < value and not last_completed.compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{ }
+}
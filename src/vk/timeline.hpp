@@ -0,0 +1,35 @@
+#pragma once
+
+namespace vulkan_eg::vkw
+{
+	// Timeline semaphore carrying a monotonically increasing value,
+	// e.g. frame number. Lets any subsystem ask "has value N completed?"
+	// without owning fences of its own.
+	class timeline
+	{
+	public:
+		explicit timeline(vk::Device &device, uint64_t initial_value = 0);
+		~timeline();
+
+		timeline() = delete;
+		timeline(const timeline &) = delete;
+		auto operator=(const timeline &) -> timeline & = delete;
+
+		[[nodiscard]] auto get() -> vk::Semaphore &;
+
+		[[nodiscard]] auto completed_value() const -> uint64_t;
+		[[nodiscard]] auto is_complete(uint64_t value) const -> bool;
+
+		// blocks host until semaphore reaches value
+		void wait(uint64_t value) const;
+
+	private:
+		// raises last_completed to value, never lowers it when threads race with older values
+		void advance(uint64_t value) const;
+
+	private:
+		vk::Device vk_device;
+		vk::Semaphore vk_semaphore;
+		mutable std::atomic<uint64_t> last_completed{0};
+	};
+}
@@ -0,0 +1,95 @@
+#include "uniform_ring.hpp"
+
+#include "devices.hpp"
+
+using namespace vulkan_eg::vkw;
+
+namespace
+{
+	auto align_up(vk::DeviceSize value, vk::DeviceSize alignment) -> vk::DeviceSize
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+uniform_ring::uniform_ring(devices *vkw_devices, memory_allocator *vkw_allocator, uint32_t frame_count,
+                           uint32_t max_allocations, vk::DeviceSize max_range, vk::BufferUsageFlags extra_usage)
+	: vkw_allocator{ vkw_allocator }, max_range{ max_range }
+{
+	auto limits = vkw_devices->get_physical_device().getProperties().limits;
+	if (max_range > limits.maxUniformBufferRange)
+	{
+		throw std::runtime_error(std::format("Uniform range of {} bytes exceeds device limit of {}.", max_range, limits.maxUniformBufferRange));
+	}
+
+	// at least a vec4, so offsets can also index a vec4 array over the whole buffer
+	alignment = std::max<vk::DeviceSize>(limits.minUniformBufferOffsetAlignment, 16);
+	// last allocation in a region still needs a whole range behind it
+	frame_size = align_up(max_allocations * align_up(max_range, alignment) + max_range, alignment);
+
+	if ((frame_size * frame_count) > std::numeric_limits<uint32_t>::max())
+	{
+		throw std::runtime_error("Uniform ring too large for 32-bit dynamic offsets.");
+	}
+
+	// read whole as a storage buffer (bindless), so one descriptor has to cover every region
+	if ((extra_usage & vk::BufferUsageFlagBits::eStorageBuffer) and (frame_size * frame_count) > limits.maxStorageBufferRange)
+	{
+		throw std::runtime_error(std::format("Uniform ring of {} bytes exceeds device's storage buffer range of {}, use fewer draws or frames in flight.",
+		                                     frame_size * frame_count, limits.maxStorageBufferRange));
+	}
+
+	auto buffer_ci = vk::BufferCreateInfo
+	{
+		.size = frame_size * frame_count,
+		.usage = vk::BufferUsageFlagBits::eUniformBuffer | extra_usage,
+		.sharingMode = vk::SharingMode::eExclusive
+	};
+	std::tie(buffer, memory) = vkw_allocator->create_buffer(buffer_ci, memory_usage::upload);
+}
+
+uniform_ring::~uniform_ring()
+{
+	vkw_allocator->destroy_buffer(buffer, memory);
+}
+
+void uniform_ring::begin_frame(uint32_t frame_index)
+{
+	frame_start = frame_size * frame_index;
+	frame_head.store(0, std::memory_order_relaxed);
+}
+
+auto uniform_ring::allocate(vk::DeviceSize size) -> std::tuple<uint32_t, std::byte *>
+{
+	if (size > max_range)
+	{
+		throw std::runtime_error(std::format("Uniform allocation of {} bytes exceeds range of {}.", size, max_range));
+	}
+
+	auto offset = frame_head.fetch_add(align_up(size, alignment), std::memory_order_relaxed);
+	if (offset + max_range > frame_size)
+	{
+		throw std::runtime_error("Uniform ring frame region is full.");
+	}
+
+	return
+	{
+		static_cast<uint32_t>(frame_start + offset),
+		memory.mapped + frame_start + offset
+	};
+}
+
+auto uniform_ring::descriptor_info() const -> vk::DescriptorBufferInfo
+{
+	return vk::DescriptorBufferInfo
+	{
+		.buffer = buffer,
+		.offset = 0,
+		.range = max_range
+	};
+}
+
+auto uniform_ring::get_buffer() const -> vk::Buffer
+{
+	return buffer;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "memory_allocator.hpp"
+
+namespace vulkan_eg::vkw
+{
+	class devices;
+
+	// One persistently mapped host visible buffer, split into a region per frame in flight.
+	// Per draw constants are bump allocated from the current frame's region and all bound through
+	// a single dynamic uniform buffer descriptor, so an allocation is just a dynamic offset.
+	// A frame's region is recycled by begin_frame, once the frame that last used it has completed.
+	class uniform_ring
+	{
+	public:
+		// Each region fits at least max_allocations allocations, max_range is the largest single allocation
+		// and the descriptor's range. extra_usage lets the buffer be read other ways too, e.g. as a storage buffer,
+		// which throws when whole ring doesn't fit in maxStorageBufferRange.
+		uniform_ring(devices *vkw_devices, memory_allocator *vkw_allocator, uint32_t frame_count,
+		             uint32_t max_allocations, vk::DeviceSize max_range = 256, vk::BufferUsageFlags extra_usage = {});
+		~uniform_ring();
+
+		uniform_ring() = delete;
+		uniform_ring(const uniform_ring &) = delete;
+		auto operator=(const uniform_ring &) -> uniform_ring & = delete;
+
+		// Call once the frame that last used frame_index has completed on GPU
+		void begin_frame(uint32_t frame_index);
+
+		// Dynamic offset and mapped memory of size bytes, valid until frame's region is recycled.
+		// Safe to call from several threads recording the same frame, throws when region is full.
+		[[nodiscard]] auto allocate(vk::DeviceSize size) -> std::tuple<uint32_t, std::byte *>;
+
+		template <typename T>
+		[[nodiscard]] auto push(const T &value) -> uint32_t
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "uniform data is copied bytewise");
+
+			auto [offset, mapped] = allocate(sizeof(T));
+			std::memcpy(mapped, &value, sizeof(T));
+			return offset;
+		}
+
+		// For a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor
+		[[nodiscard]] auto descriptor_info() const -> vk::DescriptorBufferInfo;
+		// Whole ring, offsets from allocate are relative to it and multiples of 16
+		[[nodiscard]] auto get_buffer() const -> vk::Buffer;
+
+	private:
+		memory_allocator *vkw_allocator;
+		vk::Buffer buffer;
+		allocation memory;
+
+		vk::DeviceSize alignment{};
+		vk::DeviceSize frame_size{};
+		vk::DeviceSize max_range{};
+
+		vk::DeviceSize frame_start{};
+		std::atomic<vk::DeviceSize> frame_head{0};
+	};
+}
@@ -0,0 +1,291 @@
+#include "upload_service.hpp"
+
+#include "devices.hpp"
+#include "timeline.hpp"
+
+using namespace vulkan_eg::vkw;
+
+namespace
+{
+	// bufferOffset of image copies must be a multiple of 4 and of the texel size,
+	// which isn't always a power of two (12 bytes for R32G32B32_SFLOAT), see upload_image
+	constexpr auto min_copy_alignment = vk::DeviceSize{ 4 };
+
+	auto align_up(vk::DeviceSize value, vk::DeviceSize alignment) -> vk::DeviceSize
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+upload_service::upload_service(devices *vkw_devices, memory_allocator *vkw_allocator, vk::DeviceSize ring_size)
+	: vk_device{ vkw_devices->get_device() },
+	  vk_queue{ vkw_devices->get_transfer_queue() },
+	  vkw_allocator{ vkw_allocator },
+	  ring_size{ ring_size }
+{
+	auto qf = vkw_devices->get_queue_family();
+	dedicated_queue = qf.transfer_family.has_value();
+	// uploaded data may be read on compute as well as graphics queue
+	if (auto families = qf.get_unique_indices(); families.size() > 1)
+	{
+		queue_families = std::move(families);
+	}
+
+	auto command_pool_ci = vk::CommandPoolCreateInfo
+	{
+		.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+		.queueFamilyIndex = qf.transfer_family.value_or(qf.graphics_family.value())
+	};
+	command_pool = vk_device.createCommandPool(command_pool_ci);
+
+	upload_timeline = std::make_unique<timeline>(vk_device);
+
+	auto limits = vkw_devices->get_physical_device().getProperties().limits;
+	copy_alignment = std::max(min_copy_alignment, limits.optimalBufferCopyOffsetAlignment);
+
+	auto buffer_ci = vk::BufferCreateInfo
+	{
+		.size = ring_size,
+		.usage = vk::BufferUsageFlagBits::eTransferSrc,
+		.sharingMode = vk::SharingMode::eExclusive
+	};
+	std::tie(staging_buffer, staging_memory) = vkw_allocator->create_buffer(buffer_ci, memory_usage::upload);
+}
+
+upload_service::~upload_service()
+{
+	{
+		auto lock = std::lock_guard{ upload_mutex };
+		submit_locked();
+	}
+	upload_timeline->wait(last_value);
+
+	vk_device.destroyCommandPool(command_pool);
+	vkw_allocator->destroy_buffer(staging_buffer, staging_memory);
+	upload_timeline.reset();
+}
+
+void upload_service::upload_buffer(vk::Buffer dst, vk::DeviceSize dst_offset, std::span<const std::byte> data)
+{
+	auto lock = std::lock_guard{ upload_mutex };
+
+	// larger uploads go through the ring in pieces, each one always fits once ring has drained
+	auto max_chunk = ring_size / 2;
+	while (not data.empty())
+	{
+		auto chunk = data.first(std::min<size_t>(data.size(), max_chunk));
+		auto staging_offset = allocate_staging(chunk.size(), copy_alignment);
+		std::memcpy(staging_memory.mapped + staging_offset, chunk.data(), chunk.size());
+
+		auto region = vk::BufferCopy
+		{
+			.srcOffset = staging_offset,
+			.dstOffset = dst_offset,
+			.size = chunk.size()
+		};
+		recording_buffer().copyBuffer(staging_buffer, dst, region);
+
+		dst_offset += chunk.size();
+		data = data.subspan(chunk.size());
+	}
+}
+
+void upload_service::upload_image(vk::Image dst, vk::Extent3D extent, const vk::ImageSubresourceLayers &subresource, vk::DeviceSize texel_size,
+                                  std::span<const std::byte> data, vk::ImageLayout final_layout)
+{
+	if (data.size() > ring_size / 2)
+	{
+		throw std::runtime_error(std::format("Image upload of {} bytes does not fit staging ring of {} bytes.", data.size(), ring_size));
+	}
+
+	auto lock = std::lock_guard{ upload_mutex };
+
+	auto staging_offset = allocate_staging(data.size(), std::lcm(copy_alignment, texel_size));
+	std::memcpy(staging_memory.mapped + staging_offset, data.data(), data.size());
+
+	auto cmd_buffer = recording_buffer();
+	auto range = vk::ImageSubresourceRange
+	{
+		.aspectMask = subresource.aspectMask,
+		.baseMipLevel = subresource.mipLevel,
+		.levelCount = 1,
+		.baseArrayLayer = subresource.baseArrayLayer,
+		.layerCount = subresource.layerCount
+	};
+
+	// previous contents are discarded, whole subresource is overwritten
+	auto to_transfer = vk::ImageMemoryBarrier
+	{
+		.srcAccessMask = {},
+		.dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+		.oldLayout = vk::ImageLayout::eUndefined,
+		.newLayout = vk::ImageLayout::eTransferDstOptimal,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = dst,
+		.subresourceRange = range
+	};
+	cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+	                           {}, {}, {}, to_transfer);
+
+	auto region = vk::BufferImageCopy
+	{
+		.bufferOffset = staging_offset,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = subresource,
+		.imageOffset = {0, 0, 0},
+		.imageExtent = extent
+	};
+	cmd_buffer.copyBufferToImage(staging_buffer, dst, vk::ImageLayout::eTransferDstOptimal, region);
+
+	// transfer queue may not know graphics stages, the semaphore the graphics queue waits on
+	// makes the writes visible there, so this only needs to order the layout change after the copy
+	auto to_final = vk::ImageMemoryBarrier
+	{
+		.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+		.dstAccessMask = {},
+		.oldLayout = vk::ImageLayout::eTransferDstOptimal,
+		.newLayout = final_layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = dst,
+		.subresourceRange = range
+	};
+	cmd_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+	                           {}, {}, {}, to_final);
+}
+
+auto upload_service::flush() -> uint64_t
+{
+	auto lock = std::lock_guard{ upload_mutex };
+	return submit_locked();
+}
+
+auto upload_service::submitted_value() const -> uint64_t
+{
+	auto lock = std::lock_guard{ upload_mutex };
+	return last_value;
+}
+
+auto upload_service::get_timeline() -> timeline &
+{
+	return *upload_timeline;
+}
+
+auto upload_service::sharing_families() const -> const std::vector<uint32_t> &
+{
+	return queue_families;
+}
+
+auto upload_service::has_dedicated_queue() const -> bool
+{
+	return dedicated_queue;
+}
+
+auto upload_service::allocate_staging(vk::DeviceSize size, vk::DeviceSize alignment) -> vk::DeviceSize
+{
+	while (true)
+	{
+		auto head_offset = ring_head % ring_size;
+		auto offset = align_up(head_offset, alignment);
+
+		// never split across the end of the ring, skip to its start instead
+		if (offset + size > ring_size)
+		{
+			offset = 0;
+		}
+		auto needed = (offset == 0 and head_offset != 0) ? ring_size - head_offset + size
+		                                                  : offset - head_offset + size;
+
+		if (ring_head + needed - ring_tail <= ring_size)
+		{
+			ring_head += needed;
+			return offset;
+		}
+
+		if (in_flight.empty() and not recording)
+		{
+			throw std::runtime_error(std::format("Staging allocation of {} bytes does not fit staging ring.", size));
+		}
+
+		// ring is full, queued copies have to go out before their space can come back
+		submit_locked();
+		reclaim(true);
+	}
+}
+
+void upload_service::reclaim(bool wait_oldest)
+{
+	if (wait_oldest and not in_flight.empty())
+	{
+		upload_timeline->wait(in_flight.front().value);
+	}
+
+	while (not in_flight.empty() and upload_timeline->is_complete(in_flight.front().value))
+	{
+		auto &done = in_flight.front();
+		ring_tail = done.ring_end;
+		free_buffers.push_back(done.cmd_buffer);
+		in_flight.pop_front();
+	}
+}
+
+auto upload_service::submit_locked() -> uint64_t
+{
+	if (not recording)
+	{
+		return last_value;
+	}
+
+	recording.end();
+
+	auto value = last_value + 1;
+	auto timeline_si = vk::TimelineSemaphoreSubmitInfo
+	{
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &value
+	};
+
+	auto submit_info = vk::SubmitInfo
+	{
+		.pNext = &timeline_si,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &recording,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &upload_timeline->get()
+	};
+	vk_queue.submit({submit_info});
+
+	in_flight.push_back({ .cmd_buffer = recording, .value = value, .ring_end = ring_head });
+	recording = nullptr;
+	last_value = value;
+	return value;
+}
+
+auto upload_service::recording_buffer() -> vk::CommandBuffer
+{
+	if (recording)
+	{
+		return recording;
+	}
+
+	reclaim(false);
+	if (free_buffers.empty())
+	{
+		auto cmd_buffer_alloc_info = vk::CommandBufferAllocateInfo
+		{
+			.commandPool = command_pool,
+			.level = vk::CommandBufferLevel::ePrimary,
+			.commandBufferCount = 1
+		};
+		free_buffers.push_back(vk_device.allocateCommandBuffers(cmd_buffer_alloc_info).front());
+	}
+
+	recording = free_buffers.back();
+	free_buffers.pop_back();
+
+	recording.reset();
+	recording.begin(vk::CommandBufferBeginInfo{ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	return recording;
+}
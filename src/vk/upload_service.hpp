@@ -0,0 +1,87 @@
+#pragma once
+
+#include "memory_allocator.hpp"
+
+namespace vulkan_eg::vkw
+{
+	class devices;
+	class timeline;
+
+	// Copies data into device local buffers and images through a persistently mapped staging ring.
+	// Copies are batched and submitted on the dedicated transfer queue when the device has one,
+	// so uploads don't compete with rendering on the graphics queue.
+	// Each flushed batch signals the upload timeline, graphics submissions wait on it before using the data.
+	//
+	// Resources written through the upload queue and read on another queue family must be created
+	// with VK_SHARING_MODE_CONCURRENT over sharing_families(), so no queue ownership transfer is needed.
+	class upload_service
+	{
+	public:
+		upload_service(devices *vkw_devices, memory_allocator *vkw_allocator, vk::DeviceSize ring_size = 32ull << 20);
+		~upload_service();
+
+		upload_service() = delete;
+		upload_service(const upload_service &) = delete;
+		auto operator=(const upload_service &) -> upload_service & = delete;
+
+		// Data is copied into the ring before returning, so it need not outlive the call.
+		// Blocks only when ring is full of copies still in flight, which then submits them like flush.
+		// So with a dedicated transfer queue it may be called from any thread, otherwise only from
+		// the thread that submits to graphics queue, as graphics queue submits don't take upload_service's lock.
+		void upload_buffer(vk::Buffer dst, vk::DeviceSize dst_offset, std::span<const std::byte> data);
+		// Whole subresource is written, image ends up in final_layout. Data must fit in half the ring.
+		// texel_size is bytes per texel of image's format, or per block for compressed formats. Same threading as upload_buffer.
+		void upload_image(vk::Image dst, vk::Extent3D extent, const vk::ImageSubresourceLayers &subresource, vk::DeviceSize texel_size,
+		                  std::span<const std::byte> data, vk::ImageLayout final_layout);
+
+		// Submits queued copies, returns timeline value signalled once they, and every earlier batch, are done.
+		// When device has no transfer only family, uploads go on graphics queue,
+		// so call this from the thread that submits to graphics queue.
+		auto flush() -> uint64_t;
+
+		// value of last flushed batch, 0 if nothing was ever uploaded
+		[[nodiscard]] auto submitted_value() const -> uint64_t;
+		[[nodiscard]] auto get_timeline() -> timeline &;
+
+		// empty when device uses a single queue family, no concurrent sharing needed then
+		[[nodiscard]] auto sharing_families() const -> const std::vector<uint32_t> &;
+		[[nodiscard]] auto has_dedicated_queue() const -> bool;
+
+	private:
+		struct batch
+		{
+			vk::CommandBuffer cmd_buffer;
+			uint64_t value{};
+			uint64_t ring_end{};     // ring head when submitted, space before it is free once value completes
+		};
+
+		[[nodiscard]] auto allocate_staging(vk::DeviceSize size, vk::DeviceSize alignment) -> vk::DeviceSize;
+		void reclaim(bool wait_oldest);
+		auto submit_locked() -> uint64_t;
+		auto recording_buffer() -> vk::CommandBuffer;
+
+	private:
+		vk::Device vk_device;
+		vk::Queue vk_queue;
+		memory_allocator *vkw_allocator;
+		std::unique_ptr<timeline> upload_timeline;
+
+		vk::CommandPool command_pool;
+		std::vector<vk::CommandBuffer> free_buffers;
+		std::deque<batch> in_flight;
+		vk::CommandBuffer recording;   // copies queued since last flush, null if none
+
+		vk::Buffer staging_buffer;
+		allocation staging_memory;
+		vk::DeviceSize ring_size{};
+		vk::DeviceSize copy_alignment{};  // buffer copies, image copies also align to texel size
+		uint64_t ring_head{};          // total bytes handed out, offset into ring is head % ring_size
+		uint64_t ring_tail{};          // total bytes released
+
+		std::vector<uint32_t> queue_families;
+		bool dedicated_queue{false};
+
+		mutable std::mutex upload_mutex;
+		uint64_t last_value{};
+	};
+}